@@ -0,0 +1,341 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_solver.h"
+#include "game_struct.h"
+#include "game_tools.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+#define BENCH_SEED 2024
+#define DEFAULT_RUNS 5
+#define DEFAULT_TOLERANCE 2.0
+#define MIN_TIME 1e-3 // times below 1 ms are too noisy to be compared
+#define HOT_SIZE 500 // grid of the hot path measures
+
+/** @brief Parameters of a game of the corpus (see game_random). */
+typedef struct {
+    uint nb_rows;
+    uint nb_cols;
+    bool wrapping;
+    uint nb_empty;
+    uint nb_extra;
+} bench_case;
+
+static const bench_case corpus[] = {
+    {5, 5, false, 0, 0},    {5, 5, true, 2, 2},     {10, 10, false, 5, 3},  {10, 10, true, 0, 4},
+    {15, 15, false, 0, 10}, {20, 20, false, 10, 4}, {20, 20, true, 0, 6},   {30, 30, false, 20, 5},
+    {30, 30, true, 10, 6},  {40, 40, false, 30, 6}, {40, 40, true, 0, 8},   {40, 40, true, 20, 20},
+};
+
+#define NB_CASES (sizeof(corpus) / sizeof(corpus[0]))
+
+/** @brief Measures of a game of the corpus. */
+typedef struct {
+    char name[32];
+    uint64_t solve_nodes;
+    double solve_median;
+    double solve_p95;
+    uint64_t count_nodes;
+    double count_median;
+    double count_p95;
+    uint64_t nb_solutions;
+} bench_result;
+
+/* ************************************************************************** */
+
+void usage(char* argv[]) {
+    fprintf(stderr, "Usage: %s [-b <baseline>] [-w <baseline>] [-r <runs>] [-t <tolerance>] [--strict-time]\n", argv[0]);
+    fprintf(stderr, "  -b <baseline>: compare against a baseline file\n");
+    fprintf(stderr, "  -w <baseline>: write the results as the new baseline file\n");
+    fprintf(stderr, "  -r <runs>: number of runs of each measure (default %d)\n", DEFAULT_RUNS);
+    fprintf(stderr, "  -t <tolerance>: slowdown ratio reported as slower (default %.1f)\n", DEFAULT_TOLERANCE);
+    fprintf(stderr, "  --strict-time: slower times are regressions too (not only node counts)\n");
+    exit(EXIT_FAILURE);
+}
+
+static int _compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/** sorts the times, then returns the median and the 95th percentile (nearest rank) */
+static void _summary(double* times, uint nb, double* median, double* p95) {
+    qsort(times, nb, sizeof(double), _compare_double);
+    *median = (nb % 2) ? times[nb / 2] : (times[nb / 2 - 1] + times[nb / 2]) / 2;
+    uint rank = (95 * nb + 99) / 100;
+    *p95 = times[rank > 0 ? rank - 1 : 0];
+}
+
+/* ************************************************************************** */
+
+static void _run_case(uint k, uint nb_runs, bench_result* r, double* times) {
+    const bench_case* c = &corpus[k];
+    snprintf(r->name, sizeof(r->name), "%ux%u%s_e%u_x%u", c->nb_rows, c->nb_cols, c->wrapping ? "w" : "", c->nb_empty,
+             c->nb_extra);
+    // the corpus only depends on the seed
+    srand(BENCH_SEED + k);
+    game g = game_random(c->nb_rows, c->nb_cols, c->wrapping, c->nb_empty, c->nb_extra);
+    game_shuffle_orientation(g);
+
+    game_stats stats;
+    game copy = game_copy(g);
+    for (uint run = 0; run < nb_runs; run++) {
+        game_copy_into(copy, g);
+        if (!game_solve_stats(copy, &stats) || !game_won(copy)) {
+            fprintf(stderr, "Error: %s has not been solved\n", r->name);
+            exit(EXIT_FAILURE);
+        }
+        times[run] = stats.time;
+    }
+    game_delete(copy);
+    r->solve_nodes = stats.nb_nodes;
+    _summary(times, nb_runs, &r->solve_median, &r->solve_p95);
+
+    for (uint run = 0; run < nb_runs; run++) {
+        r->nb_solutions = game_nb_solutions_stats(g, &stats);
+        times[run] = stats.time;
+    }
+    r->count_nodes = stats.nb_nodes;
+    _summary(times, nb_runs, &r->count_median, &r->count_p95);
+    game_delete(g);
+}
+
+static void _print_result(const bench_result* r) {
+    printf("%-16s solve %10.6f %10.6f %10" PRIu64 " %12.0f | count %10.6f %10.6f %10" PRIu64 " %12.0f | %" PRIu64 "\n", r->name,
+           r->solve_median, r->solve_p95, r->solve_nodes, r->solve_nodes / (r->solve_median > 0 ? r->solve_median : 1),
+           r->count_median, r->count_p95, r->count_nodes, r->count_nodes / (r->count_median > 0 ? r->count_median : 1),
+           r->nb_solutions);
+}
+
+/* ************************************************************************** */
+
+static double _now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** @brief A hot path of the library, run on a whole grid. */
+typedef struct {
+    const char* name;
+    void (*run)(cgame g, FILE* out);
+} hot_path;
+
+/*
+ * The same scan of every square, through the checked public getters and through
+ * the inline flat-index accessor of game_struct.h: each step depends on the
+ * previous one, so the compiler cannot vectorize the inline loop away and the
+ * ratio of the two times is the cost of the checks and of the calls.
+ */
+static void _run_scan_checked(cgame g, FILE* out) {
+    uint32_t h = 0;
+    for (uint i = 0; i < game_nb_rows(g); i++)
+        for (uint j = 0; j < game_nb_cols(g); j++)
+            h = 31 * h + (game_get_piece_shape(g, i, j) << 2 | game_get_piece_orientation(g, i, j));
+    fprintf(out, "%u", h);
+}
+
+static void _run_scan_inline(cgame g, FILE* out) {
+    uint32_t h = 0;
+    uint size = game_nb_rows(g) * game_nb_cols(g);
+    for (uint k = 0; k < size; k++) h = 31 * h + game_cell(g, k);
+    fprintf(out, "%u", h);
+}
+
+static void _run_solver_setup(cgame g, FILE* out) {
+    (void)out;
+    solver* s = solver_new(g);
+    if (!s) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    solver_delete(s);
+}
+
+static void _run_nb_components(cgame g, FILE* out) { fprintf(out, "%u", game_nb_components(g)); }
+
+static void _run_write(cgame g, FILE* out) { game_write(g, out); }
+
+static const hot_path hot_paths[] = {
+    {"scan_checked", _run_scan_checked}, // keep the two scans first (see _bench_hot_paths)
+    {"scan_inline", _run_scan_inline},
+    {"solver_new", _run_solver_setup},
+    {"game_nb_components", _run_nb_components},
+    {"game_write", _run_write},
+};
+
+/** median time per square of the hot paths that go through every square */
+static void _bench_hot_paths(uint nb_runs, double* times) {
+    srand(BENCH_SEED);
+    game g = game_random(HOT_SIZE, HOT_SIZE, false, 0, 0);
+    game_shuffle_orientation(g);
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    if (!out) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    double medians[sizeof(hot_paths) / sizeof(hot_paths[0])];
+    for (uint k = 0; k < sizeof(hot_paths) / sizeof(hot_paths[0]); k++) {
+        for (uint run = 0; run < nb_runs; run++) {
+            rewind(out);
+            double start = _now();
+            hot_paths[k].run(g, out);
+            times[run] = _now() - start;
+        }
+        double p95;
+        _summary(times, nb_runs, &medians[k], &p95);
+        printf("%-18s %ux%u %8.2f ns/square\n", hot_paths[k].name, HOT_SIZE, HOT_SIZE, medians[k] / (HOT_SIZE * HOT_SIZE) * 1e9);
+    }
+    printf("inline accessors: %.1fx faster than the checked getters\n", medians[0] / (medians[1] > 0 ? medians[1] : 1e-9));
+    fclose(out);
+    free(text);
+    game_delete(g);
+}
+
+/* ************************************************************************** */
+
+static void _write_baseline(const char* filename, const bench_result* results) {
+    FILE* f = fopen(filename, "w");
+    if (!f) {
+        fprintf(stderr, "Error: unable to open %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(f, "# name solve_nodes solve_median count_nodes count_median nb_solutions\n");
+    for (uint k = 0; k < NB_CASES; k++) {
+        const bench_result* r = &results[k];
+        fprintf(f, "%s %" PRIu64 " %.6f %" PRIu64 " %.6f %" PRIu64 "\n", r->name, r->solve_nodes, r->solve_median, r->count_nodes,
+                r->count_median, r->nb_solutions);
+    }
+    fclose(f);
+}
+
+/** flags a slower time (only a regression in strict mode) */
+static bool _check_time(const char* name, const char* what, double time, double base, double tolerance, bool strict) {
+    if (time < MIN_TIME || time <= base * tolerance) return true;
+    printf("%s %s: %s %.6f s instead of %.6f s\n", strict ? "REGRESSION" : "slower", name, what, time, base);
+    return !strict;
+}
+
+/**
+ * @brief Compares the results with a baseline file.
+ * @details Node counts do not depend on the machine, so any increase is a
+ * regression; times are only compared with a tolerance. A game of the corpus
+ * without a baseline line, or a line without a game, is an error too (a
+ * renamed or dropped game would hide its regressions).
+ * @return the number of regressions
+ */
+static uint _compare_baseline(const char* filename, const bench_result* results, double tolerance, bool strict) {
+    FILE* f = fopen(filename, "r");
+    if (!f) {
+        printf("no baseline %s, nothing to compare\n", filename);
+        return 0;
+    }
+    uint nb_regressions = 0;
+    bool seen[NB_CASES] = {false};
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+        char name[32];
+        uint64_t solve_nodes, count_nodes, nb_solutions;
+        double solve_median, count_median;
+        if (sscanf(line, "%31s %" SCNu64 " %lf %" SCNu64 " %lf %" SCNu64, name, &solve_nodes, &solve_median, &count_nodes,
+                   &count_median, &nb_solutions) != 6) {
+            fprintf(stderr, "Error: invalid baseline line \"%s\"\n", line);
+            exit(EXIT_FAILURE);
+        }
+        const bench_result* r = NULL;
+        for (uint k = 0; k < NB_CASES && !r; k++) {
+            if (strcmp(results[k].name, name) == 0) {
+                r = &results[k];
+                seen[k] = true;
+            }
+        }
+        if (!r) {
+            printf("ERROR %s: in the baseline but not in the corpus\n", name);
+            nb_regressions++;
+            continue;
+        }
+        if (r->nb_solutions != nb_solutions) {
+            printf("ERROR %s: %" PRIu64 " solutions instead of %" PRIu64 "\n", name, r->nb_solutions, nb_solutions);
+            nb_regressions++;
+        }
+        if (r->solve_nodes > solve_nodes || r->count_nodes > count_nodes) {
+            printf("REGRESSION %s: %" PRIu64 "/%" PRIu64 " nodes instead of %" PRIu64 "/%" PRIu64 "\n", name, r->solve_nodes,
+                   r->count_nodes, solve_nodes, count_nodes);
+            nb_regressions++;
+        }
+        if (!_check_time(name, "solve", r->solve_median, solve_median, tolerance, strict)) nb_regressions++;
+        if (!_check_time(name, "count", r->count_median, count_median, tolerance, strict)) nb_regressions++;
+    }
+    fclose(f);
+    for (uint k = 0; k < NB_CASES; k++) {
+        if (!seen[k]) {
+            printf("ERROR %s: not in the baseline\n", results[k].name);
+            nb_regressions++;
+        }
+    }
+    return nb_regressions;
+}
+
+/* ************************************************************************** */
+
+int main(int argc, char* argv[]) {
+    char* baseline = NULL;
+    char* output = NULL;
+    uint nb_runs = DEFAULT_RUNS;
+    double tolerance = DEFAULT_TOLERANCE;
+    bool strict = false;
+    for (int k = 1; k < argc; k++) {
+        if (strcmp(argv[k], "--strict-time") == 0) {
+            strict = true;
+        } else if (k + 1 >= argc) {
+            usage(argv);
+        } else if (strcmp(argv[k], "-b") == 0) {
+            baseline = argv[++k];
+        } else if (strcmp(argv[k], "-w") == 0) {
+            output = argv[++k];
+        } else if (strcmp(argv[k], "-r") == 0) {
+            nb_runs = strtoul(argv[++k], NULL, 10);
+        } else if (strcmp(argv[k], "-t") == 0) {
+            tolerance = strtod(argv[++k], NULL);
+        } else {
+            usage(argv);
+        }
+    }
+    if (nb_runs == 0) usage(argv);
+
+    bench_result results[NB_CASES];
+    double* times = malloc(nb_runs * sizeof(double));
+    if (!times) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("%-16s %-5s %10s %10s %10s %12s | %-5s %10s %10s %10s %12s | %s\n", "game", "", "median", "p95", "nodes", "nodes/s",
+           "", "median", "p95", "nodes", "nodes/s", "solutions");
+    for (uint k = 0; k < NB_CASES; k++) {
+        _run_case(k, nb_runs, &results[k], times);
+        _print_result(&results[k]);
+    }
+    _bench_hot_paths(nb_runs, times);
+    free(times);
+
+    uint nb_regressions = baseline ? _compare_baseline(baseline, results, tolerance, strict) : 0;
+    if (output) _write_baseline(output, results);
+    if (nb_regressions > 0) {
+        printf("%u regression(s)\n", nb_regressions);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -2,7 +2,7 @@
 #include "game_aux.h"
 #include "game_ext.h"
 #include "game_struct.h"
-#include "queue/queue.h"
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,29 +12,12 @@
  * Returns a pointer to the game structure, or NULL in case of error.
  */
 game game_new_empty(void) {
-    // allocate memory for the game structure
-    game g = malloc(sizeof(game_s));
+    // the structure and the grid come from a single allocation
+    game g = _game_alloc(DEFAULT_SIZE, DEFAULT_SIZE, false);
     if (!g) {
         fprintf(stderr, "Error creating the game\n");
         return NULL;
     }
-
-    // total size of the grid
-    uint size = DEFAULT_SIZE * DEFAULT_SIZE;
-    g->nb_columns = DEFAULT_SIZE;
-    g->nb_rows = DEFAULT_SIZE;
-    g->wrapping = false;
-    g->undo_stack = queue_new();
-    g->redo_stack = queue_new();
-
-    // allocate and initialize the shape and direction arrays
-    g->s = calloc(size, sizeof(shape));
-    g->d = calloc(size, sizeof(direction));
-    // check allocations
-    if (!g->s || !g->d || !g->undo_stack || !g->redo_stack) {
-        game_delete(g);
-        return NULL;
-    }
     return g; // return the created game
 }
 
@@ -54,9 +37,9 @@ game game_new(shape* shapes, direction* orientations) {
     uint size = DEFAULT_SIZE * DEFAULT_SIZE;
     // Initialize shapes and orientations for each cell
     for (uint i = 0; i < size; i++) {
-        g->s[i] = (shapes) ? shapes[i] : EMPTY;
-        g->d[i] = (orientations) ? orientations[i] : NORTH;
+        g->cells[i] = ((shapes) ? shapes[i] : EMPTY) << 2 | ((orientations) ? orientations[i] : NORTH);
     }
+    _game_rebuild(g);
     return g;
 }
 
@@ -68,21 +51,55 @@ game game_copy(cgame g) {
     if (g == NULL) {
         return NULL;
     }
-    uint size = game_nb_rows(g) * game_nb_cols(g);
-    game new_game = game_new_empty();
+    // a single allocation of the right size
+    game new_game = _game_alloc(game_nb_rows(g), game_nb_cols(g), game_is_wrapping(g));
     if (new_game == NULL) {
         fprintf(stderr, "Memory allocation error\n");
         return NULL;
     }
-    // Copy properties and arrays
-    memcpy(new_game->s, g->s, size * sizeof(shape));
-    memcpy(new_game->d, g->d, size * sizeof(direction));
-    new_game->nb_rows = game_nb_rows(g);
-    new_game->nb_columns = game_nb_cols(g);
-    new_game->wrapping = game_is_wrapping(g);
+    game_copy_into(new_game, g);
     return new_game;
 }
 
+/**
+ * Copies a game into another one, reusing its storage when it is large enough.
+ */
+void game_copy_into(game dst, cgame src) {
+    if (!dst || !src) {
+        fprintf(stderr, "Error in parameters\n");
+        exit(EXIT_FAILURE);
+    }
+    if (dst == src) return;
+    size_t capacity = _game_storage_size(src->nb_rows, src->nb_columns);
+    if (capacity > dst->capacity) {
+        // the structure cannot move: the grid goes to a separate block
+        void* storage = malloc(capacity);
+        if (!storage) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        free(dst->storage);
+        dst->storage = storage;
+        dst->capacity = capacity;
+        dst->edges = storage;
+    }
+    size_t nb_edges = (size_t)NB_DIRS * src->nb_rows * src->nb_words;
+    dst->nb_rows = src->nb_rows;
+    dst->nb_columns = src->nb_columns;
+    dst->wrapping = src->wrapping;
+    dst->nb_words = src->nb_words;
+    dst->cells = (uint8_t*)(dst->edges + nb_edges);
+    // Copy properties and arrays (but not the history)
+    memcpy(dst->edges, src->edges, nb_edges * sizeof(uint64_t));
+    memcpy(dst->cells, src->cells, (size_t)src->nb_rows * src->nb_columns);
+    dst->nb_mismatches = src->nb_mismatches;
+    dst->connected = src->connected;
+    dst->connected_valid = src->connected_valid;
+    dst->history.first = 0;
+    dst->history.nb_undo = 0;
+    dst->history.nb_redo = 0;
+}
+
 /**
  * Compares two games to check if they are identical.
  * If ignore_orientation is true, only shapes are compared.
@@ -107,16 +124,17 @@ bool game_equal(cgame g1, cgame g2, bool ignore_orientation) {
     // Calculate total size
     uint size = rows1 * cols1;
 
-    // Compare shapes with memcmp
-    if (memcmp(g1->s, g2->s, size * sizeof(shape)) != 0) {
-        return false;
-    }
-
-    // If orientation is not ignored, compare orientations
+    // Compare the cells with memcmp (or only their shapes)
     if (!ignore_orientation) {
-        if (memcmp(g1->d, g2->d, size * sizeof(direction)) != 0) {
+        if (memcmp(g1->cells, g2->cells, size) != 0) {
             return false;
         }
+    } else {
+        for (uint i = 0; i < size; i++) {
+            if (_game_shape(g1, i) != _game_shape(g2, i)) {
+                return false;
+            }
+        }
     }
 
     // Compare wrapping option
@@ -134,11 +152,9 @@ void game_delete(game g) {
     if (g == NULL) {
         return;
     }
-    free(g->s);
-    free(g->d);
-    queue_free_full(g->undo_stack, free);
-    queue_free_full(g->redo_stack, free);
-    free(g);
+    free(g->history.moves);
+    free(g->storage);
+    free(g); // unless it has grown, the grid is in the same block
 }
 
 /**
@@ -154,7 +170,8 @@ void game_set_piece_shape(game g, uint i, uint j, shape s) {
         fprintf(stderr, "Invalid shape\n");
         exit(1);
     }
-    g->s[i * game_nb_cols(g) + j] = s;
+    _game_set_square(g, i, j, s, _game_orientation(g, i * g->nb_columns + j));
+    _game_update_won(g);
 }
 
 /**
@@ -168,8 +185,10 @@ void game_set_piece_orientation(game g, uint i, uint j, direction o) {
     // Check if direction is valid
     if (o != NORTH && o != EAST && o != SOUTH && o != WEST) {
         fprintf(stderr, "Invalid orientation\n");
+        exit(1);
     }
-    g->d[i * game_nb_cols(g) + j] = o;
+    _game_set_square(g, i, j, _game_shape(g, i * g->nb_columns + j), o);
+    _game_update_won(g);
 }
 
 /**
@@ -180,7 +199,7 @@ shape game_get_piece_shape(cgame g, uint i, uint j) {
         fprintf(stderr, "Invalid indices or game.\n");
         exit(EXIT_FAILURE);
     }
-    return g->s[i * game_nb_cols(g) + j];
+    return _game_shape(g, i * g->nb_columns + j);
 }
 
 /**
@@ -195,7 +214,7 @@ direction game_get_piece_orientation(cgame g, uint i, uint j) {
         fprintf(stderr, "Error in indices\n");
         exit(1);
     }
-    return g->d[i * game_nb_cols(g) + j];
+    return _game_orientation(g, i * g->nb_columns + j);
 }
 
 /**
@@ -210,64 +229,237 @@ void game_play_move(game g, uint i, uint j, int nb_quarter_turns) {
         fprintf(stderr, "Error in indices\n");
         exit(1);
     }
-    int* move = malloc(3 * sizeof(int));
-    if (!move) {
-        fprintf(stderr, "Memory allocation error\n");
-        exit(EXIT_FAILURE);
-    }
-    move[0] = i;
-    move[1] = j;
-    move[2] = nb_quarter_turns;
-    queue_push_tail(g->undo_stack, move);
-    while (!queue_is_empty(g->redo_stack)) {
-        free(queue_pop_head(g->redo_stack));
-    }
     int move2 = (nb_quarter_turns % 4 + 4) % 4;
-    for (uint k = 0; k < move2; k++) {
-        if (g->d[i * game_nb_cols(g) + j] == WEST) {
-            g->d[i * game_nb_cols(g) + j] = NORTH;
-        } else {
-            g->d[i * game_nb_cols(g) + j] += 1;
-        }
-    }
+    uint index = i * g->nb_columns + j;
+    _game_history_push(g, HISTORY_MOVE(index, move2));
+    _game_set_square(g, i, j, _game_shape(g, index), (_game_orientation(g, index) + move2) % NB_DIRS);
+    _game_update_won(g);
 }
 
 /**
  * Checks whether the game is won.
+ * The number of mismatched edges and the connectivity are maintained by the
+ * functions that modify the grid, so this is a constant-time read (the full
+ * check is only run in builds defining GAME_DEBUG, as a cross-check).
  */
 bool game_won(cgame g) {
     if (!g) {
         fprintf(stderr, "Error: invalid game pointer.\n");
         exit(EXIT_FAILURE);
     }
-    return game_is_well_paired(g) && game_is_connected(g);
+    // the connectivity is always up to date when the grid is well paired
+    assert(g->nb_mismatches != 0 || g->connected_valid);
+    bool won = g->nb_mismatches == 0 && g->connected;
+#ifdef GAME_DEBUG
+    assert(won == (game_is_well_paired(g) && game_is_connected(g)));
+#endif
+    return won;
 }
 
 /**
  * Resets the orientation of all pieces in the game to NORTH.
  */
 void game_reset_orientation(game g) {
-    if (!g && !g->d) {
+    if (!g) {
         fprintf(stderr, "Error in parameters\n");
         exit(1);
     }
-    int size = game_nb_rows(g) * game_nb_cols(g);
-    for (uint i = 0; i < size; i++) {
-        g->d[i] = NORTH;
+    for (uint i = 0; i < game_nb_rows(g); i++) {
+        for (uint j = 0; j < game_nb_cols(g); j++) {
+            _game_set_square(g, i, j, _game_shape(g, i * g->nb_columns + j), NORTH);
+        }
     }
+    _game_update_won(g);
 }
 
 /**
  * Randomizes the orientation of all pieces in the game.
  */
 void game_shuffle_orientation(game g) {
-    if (!g) {
+    // the default generator is seeded from rand(), so that srand() still applies
+    game_rng rng;
+    game_rng_seed(&rng, rand());
+    game_shuffle_orientation_r(g, &rng);
+}
+
+void game_shuffle_orientation_r(game g, game_rng* rng) {
+    if (!g || !rng) {
         fprintf(stderr, "Error in parameters\n");
         exit(1);
     }
-    int size = game_nb_rows(g) * game_nb_cols(g);
-    for (uint i = 0; i < size; i++) {
-        int randomNumber = rand() % 4;
-        g->d[i] = randomNumber;
+    for (uint i = 0; i < game_nb_rows(g); i++) {
+        for (uint j = 0; j < game_nb_cols(g); j++) {
+            direction o = game_rng_below(rng, NB_DIRS);
+            _game_set_square(g, i, j, _game_shape(g, i * g->nb_columns + j), o);
+        }
+    }
+    _game_update_won(g);
+}
+
+/* ************************************************************************** */
+
+/** half-edge code of a piece (0 for an invalid piece) */
+static uint _game_code(shape s, direction o) { return (s < NB_SHAPES && o < NB_DIRS) ? _code[s][o] : 0; }
+
+/** writes the half-edge code of square (i,j) in the planes */
+static void _game_store_code(game g, uint i, uint j, uint code) {
+    uint64_t bit = (uint64_t)1 << (j % 64);
+    for (direction d = NORTH; d < NB_DIRS; d++) {
+        uint64_t* word = &_game_plane(g, d, i)[j / 64];
+        if (code & (0b1000 >> d)) {
+            *word |= bit;
+        } else {
+            *word &= ~bit;
+        }
+    }
+}
+
+/** largest buffer allowed by the policy, in moves (0: no limit) */
+static uint _history_max_capacity(const game_history* h) {
+    if (h->policy.max_bytes == 0) return 0;
+    size_t nb = h->policy.max_bytes / sizeof(uint32_t);
+    uint capacity = 1;
+    while (capacity <= UINT32_MAX / 4 && 2 * (size_t)capacity <= nb) capacity *= 2;
+    return capacity;
+}
+
+/** maximum number of moves that can be undone (0: no limit) */
+static uint _history_limit(const game_history* h) {
+    uint limit = h->policy.max_moves;
+    uint capacity = _history_max_capacity(h);
+    if (capacity > 0 && (limit == 0 || capacity < limit)) limit = capacity;
+    return limit;
+}
+
+/** drops the oldest moves so that at most nb moves can be undone */
+static void _history_trim(game_history* h, uint nb) {
+    if (h->nb_undo <= nb) return;
+    uint nb_dropped = h->nb_undo - nb;
+    h->first = (h->first + nb_dropped) & (h->capacity - 1);
+    h->nb_undo -= nb_dropped;
+}
+
+/** moves the history to a new buffer, the oldest move at index 0 (the extra cancelled moves are lost) */
+static void _history_resize(game g, uint capacity) {
+    game_history* h = &g->history;
+    uint32_t* moves = malloc(capacity * sizeof(uint32_t));
+    if (!moves) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    uint nb = h->nb_undo + h->nb_redo < capacity ? h->nb_undo + h->nb_redo : capacity;
+    for (uint k = 0; k < nb; k++) moves[k] = *_game_history_at(g, k);
+    free(h->moves);
+    h->moves = moves;
+    h->capacity = capacity;
+    h->first = 0;
+    h->nb_redo = nb - h->nb_undo;
+}
+
+void _game_history_push(game g, uint32_t move) {
+    game_history* h = &g->history;
+    h->nb_redo = 0;
+    if (h->policy.coalesce) {
+        // consecutive rotations of a square make one move, which vanishes after a full turn
+        uint32_t* last = h->nb_undo > 0 ? _game_history_at(g, h->nb_undo - 1) : NULL;
+        if (last && HISTORY_INDEX(*last) == HISTORY_INDEX(move)) {
+            uint turns = (HISTORY_TURNS(*last) + HISTORY_TURNS(move)) % NB_DIRS;
+            if (turns == 0) h->nb_undo--;
+            else *last = HISTORY_MOVE(HISTORY_INDEX(move), turns);
+            return;
+        }
+        if (HISTORY_TURNS(move) == 0) return;
+    }
+    uint limit = _history_limit(h);
+    if (limit > 0) _history_trim(h, limit - 1);
+    if (h->nb_undo == h->capacity) {
+        // double the buffer (the trimming above keeps it within max_bytes)
+        uint capacity = h->capacity ? 2 * h->capacity : 16;
+        uint max_capacity = _history_max_capacity(h);
+        _history_resize(g, max_capacity > 0 && max_capacity < capacity ? max_capacity : capacity);
+    }
+    *_game_history_at(g, h->nb_undo++) = move;
+}
+
+void _game_history_fit(game g) {
+    game_history* h = &g->history;
+    uint limit = _history_limit(h);
+    if (limit > 0) _history_trim(h, limit);
+    uint max_capacity = _history_max_capacity(h);
+    if (max_capacity > 0 && h->capacity > max_capacity) _history_resize(g, max_capacity);
+}
+
+size_t _game_storage_size(uint nb_rows, uint nb_cols) {
+    size_t nb_words = (nb_cols + 63) / 64;
+    return NB_DIRS * nb_rows * nb_words * sizeof(uint64_t) + (size_t)nb_rows * nb_cols;
+}
+
+game _game_alloc(uint nb_rows, uint nb_cols, bool wrapping) {
+    uint nb_words = (nb_cols + 63) / 64;
+    size_t nb_edges = (size_t)NB_DIRS * nb_rows * nb_words;
+    size_t capacity = _game_storage_size(nb_rows, nb_cols);
+    // sizeof(game_s) is a multiple of 8 (it holds pointers): the planes are aligned
+    game g = calloc(1, sizeof(game_s) + capacity);
+    if (!g) return NULL;
+    g->capacity = capacity;
+    g->nb_rows = nb_rows;
+    g->nb_columns = nb_cols;
+    g->wrapping = wrapping;
+    g->connected = true;
+    g->connected_valid = true;
+    g->nb_words = nb_words;
+    g->edges = (uint64_t*)(g + 1);
+    g->cells = (uint8_t*)(g->edges + nb_edges);
+    return g;
+}
+
+void _game_rebuild(game g) {
+    for (uint i = 0; i < g->nb_rows; i++) {
+        for (uint j = 0; j < g->nb_columns; j++) {
+            uint index = i * g->nb_columns + j;
+            _game_store_code(g, i, j, _game_code(_game_shape(g, index), _game_orientation(g, index)));
+        }
+    }
+    g->nb_mismatches = _game_edge_mismatches(g);
+    g->connected_valid = false;
+    _game_update_won(g);
+}
+
+uint _game_local_mismatches(cgame g, uint i, uint j) {
+    uint nb = 0;
+    for (direction d = NORTH; d < NB_DIRS; d++) {
+        uint ni, nj;
+        bool next = game_get_ajacent_square(g, i, j, d, &ni, &nj);
+        // an edge looping back onto the square is seen from both its sides
+        if (next && ni == i && nj == j && d >= SOUTH) continue;
+        bool he = _game_half_edge(g, i, j, d);
+        if (next ? he != _game_half_edge(g, ni, nj, (d + 2) % NB_DIRS) : he) nb++;
+    }
+    return nb;
+}
+
+void _game_set_square(game g, uint i, uint j, shape s, direction o) {
+    uint index = i * g->nb_columns + j;
+    uint8_t cell = g->cells[index];
+    uint code = _game_code(s, o);
+    g->cells[index] = s << 2 | o;
+    // same half-edges (a symmetric piece, or no rotation): nothing else changes
+    if (code == _game_code(game_cell_shape(cell), game_cell_orientation(cell))) return;
+    uint before = _game_local_mismatches(g, i, j);
+    _game_store_code(g, i, j, code);
+    g->nb_mismatches = g->nb_mismatches - before + _game_local_mismatches(g, i, j);
+    g->connected_valid = false;
+}
+
+/**
+ * The connectivity only changes with the half-edges, and a move that changes
+ * the half-edges of a square of a well-paired grid breaks its pairing (the
+ * neighbours are unchanged). So the flood fill only runs when a move makes the
+ * grid well paired, not on the moves that keep it so.
+ */
+void _game_update_won(game g) {
+    if (g->nb_mismatches == 0 && !g->connected_valid) {
+        g->connected = game_is_connected(g);
+        g->connected_valid = true;
     }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "game_ext.h"
 #include "game_struct.h"
 #include "queue/queue.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,8 +30,9 @@ void game_print(cgame g) {
     for (uint i = 0; i < game_nb_rows(g) && i < 10; i++) {
         printf("%u |", i);
         for (uint j = 0; j < game_nb_cols(g) && j < 10; j++) {
-            shape s = game_get_piece_shape(g, i, j);
-            direction d = game_get_piece_orientation(g, i, j);
+            uint8_t cell = game_cell(g, i * g->nb_columns + j);
+            shape s = game_cell_shape(cell);
+            direction d = game_cell_orientation(cell);
 
             // Display the piece according to its shape and orientation
             if (s == EMPTY) {
@@ -137,6 +139,7 @@ game game_default_solution(void) {
             game_set_piece_shape(g, i, j, shapes[i * game_nb_cols(g) + j]);
         }
     }
+    _game_update_won(g);
     return g;
 }
 
@@ -169,25 +172,9 @@ bool game_get_ajacent_square(cgame g, uint i, uint j, direction d, uint* pi_next
 }
 
 bool game_has_half_edge(cgame g, uint i, uint j, direction d) {
-    if (!g || i >= game_nb_rows(g) || j >= game_nb_cols(g)) return false;
-
-    shape s = game_get_piece_shape(g, i, j);
-    direction dir = game_get_piece_orientation(g, i, j);
-
-    // Check based on the shape of the piece
-    if (s == EMPTY) return false;
-    if (s == ENDPOINT) return (d == dir);
-    if (s == SEGMENT)
-        return (d == NORTH || d == SOUTH) ? (dir == NORTH || dir == SOUTH)
-                                          : (dir == EAST || dir == WEST);
-    if (s == CORNER)
-        return (d == dir) || (d == (dir + 1) % 4);
-    if (s == TEE)
-        return d != ((dir + 2) % 4); // Opposite direction is invalid
-    if (s == CROSS)
-        return true;
-
-    return false;
+    if (!g || i >= g->nb_rows || j >= g->nb_columns || d >= NB_DIRS) return false;
+    // the half-edges are kept in bit planes, with the encoding of _code
+    return _game_half_edge(g, i, j, d);
 }
 
 edge_status game_check_edge(cgame g, uint i, uint j, direction d) {
@@ -205,60 +192,67 @@ edge_status game_check_edge(cgame g, uint i, uint j, direction d) {
 }
 
 bool game_is_well_paired(cgame g) {
-    // Check all squares in the grid
-    for (uint i = 0; i < game_nb_rows(g); i++) {
-        for (uint j = 0; j < game_nb_cols(g); j++) {
-            for (direction d = NORTH; d <= WEST; d++) {
-                if (game_has_half_edge(g, i, j, d)) {
-                    if (game_check_edge(g, i, j, d) != MATCH) return false;
-                }
-            }
-        }
-    }
-    return true;
+    // Check all the edges of the grid, 64 squares at a time
+    return _game_edge_mismatches(g) == 0;
 }
 
-bool connectedRec(cgame g, uint si, uint sj, uint fi, uint fj, bool tab[]) {
-    uint si_next, sj_next;
-    tab[game_nb_cols(g) * si + sj] = true;
-    if (si == fi && sj == fj) return true;
-
-    for (direction d = NORTH; d <= WEST; d++) {
-        if (game_check_edge(g, si, sj, d) == MATCH) {
-            game_get_ajacent_square(g, si, sj, d, &si_next, &sj_next);
-            if (!tab[si_next * game_nb_cols(g) + sj_next]) {
-                if (connectedRec(g, si_next, sj_next, fi, fj, tab)) return true;
-            }
+/**
+ * @brief Visits the network of a given square with an explicit work stack.
+ * @param g the game
+ * @param start index of the first square (row-major)
+ * @param stack work stack of nb_rows*nb_cols squares
+ * @param visited bitset of the visited squares
+ */
+static void _flood_fill(cgame g, uint start, uint* stack, uint64_t* visited) {
+    uint nb_cols = game_nb_cols(g);
+    uint top = 0;
+    stack[top++] = start;
+    visited[start / 64] |= (uint64_t)1 << (start % 64);
+    while (top > 0) {
+        uint index = stack[--top];
+        uint i = index / nb_cols, j = index % nb_cols;
+        for (direction d = NORTH; d <= WEST; d++) {
+            uint i_next, j_next;
+            if (!_game_half_edge(g, i, j, d)) continue;
+            if (!game_get_ajacent_square(g, i, j, d, &i_next, &j_next)) continue;
+            if (!_game_half_edge(g, i_next, j_next, (d + 2) % NB_DIRS)) continue;
+            uint next = i_next * nb_cols + j_next;
+            if (visited[next / 64] & ((uint64_t)1 << (next % 64))) continue;
+            visited[next / 64] |= (uint64_t)1 << (next % 64);
+            stack[top++] = next;
         }
     }
-    return false;
 }
 
-bool game_is_connected(cgame g) {
-    bool tab[game_nb_rows(g) * game_nb_cols(g)];
-    uint si = 0, sj = 0;
-    bool found = false;
-
-    // Find the first non-empty piece
-    for (uint i = 0; i < game_nb_rows(g) && !found; i++) {
-        for (uint j = 0; j < game_nb_cols(g) && !found; j++) {
-            if (game_get_piece_shape(g, i, j) != EMPTY) {
-                si = i;
-                sj = j;
-                found = true;
-            }
-        }
+/**
+ * @brief Counts the networks of the game in a single pass.
+ * @param g the game
+ * @param stop_early if true, stops as soon as a second network is found
+ * @return the number of networks (or 2 if stopped early)
+ */
+static uint _count_components(cgame g, bool stop_early) {
+    uint size = game_nb_rows(g) * game_nb_cols(g);
+    uint* stack = malloc(size * sizeof(uint));
+    uint64_t* visited = calloc((size + 63) / 64, sizeof(uint64_t));
+    if (!stack || !visited) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
     }
 
-    if (!found) return true; // Empty board is trivially connected
-
-    for (uint k = 0; k < game_nb_rows(g); k++) {
-        for (uint l = 0; l < game_nb_cols(g); l++) {
-            if (game_get_piece_shape(g, k, l) != EMPTY) {
-                memset(tab, 0, sizeof(tab));
-                if (!connectedRec(g, si, sj, k, l, tab)) return false;
-            }
-        }
+    uint nb = 0;
+    for (uint index = 0; index < size; index++) {
+        if (visited[index / 64] & ((uint64_t)1 << (index % 64))) continue;
+        if (_game_shape(g, index) == EMPTY) continue;
+        nb++;
+        if (stop_early && nb > 1) break;
+        _flood_fill(g, index, stack, visited);
     }
-    return true;
+
+    free(stack);
+    free(visited);
+    return nb;
 }
+
+bool game_is_connected(cgame g) { return _count_components(g, true) <= 1; }
+
+uint game_nb_components(cgame g) { return _count_components(g, false); }
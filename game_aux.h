@@ -96,6 +96,20 @@ edge_status game_check_edge(cgame g, uint i, uint j, direction d);
  */
 bool game_is_well_paired(cgame g);
 
+/**
+ * @brief Checks all the edges of the grid at once.
+ * @details The half-edges of whole rows are compared with vector instructions
+ * (AVX2 or SSE2, chosen at runtime, with a scalar fallback): the east bits of
+ * each row against its west bits shifted by one column, the south bits of each
+ * row against the north bits of the next one, including the wraparound column
+ * and row when the game is wrapping.
+ * @param g the game
+ * @param[out] nb_mismatches number of mismatched edges (output, may be NULL)
+ * @pre @p g must be a valid pointer toward a game structure.
+ * @return true if the game is well paired, false otherwise
+ */
+bool game_check_edges(cgame g, uint* nb_mismatches);
+
 /**
  * @brief Checks if the game is connected.
  * @details This function checks that all the pieces are connected, i.e. there
@@ -106,4 +120,15 @@ bool game_is_well_paired(cgame g);
  */
 bool game_is_connected(cgame g);
 
+/**
+ * @brief Counts the networks of the game.
+ * @details A network is a set of non-empty pieces linked together by
+ * well-matched edges. The game is connected when there is at most one network,
+ * so this count can be displayed as the progress of the player.
+ * @param g the game
+ * @pre @p g must be a valid pointer toward a game structure.
+ * @return the number of networks (0 if all the squares are empty)
+ */
+uint game_nb_components(cgame g);
+
 #endif // __GAME_AUX_H__
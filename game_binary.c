@@ -0,0 +1,426 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_struct.h"
+#include "game_tools.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+/**
+ * @brief Binary file format (little-endian).
+ * @details A 16-byte header: the magic "NETB", the version, a flags byte (bit
+ * 0: wrapping), 2 reserved bytes, then the number of rows and of columns on 4
+ * bytes each. It is followed by one byte per square, in row-major order, with
+ * the shape in the high bits and the orientation in the 2 low bits.
+ *
+ * An archive starts with an 8-byte header (magic "NETA", version), followed by
+ * games in the binary format above, one after the other. Then comes the index:
+ * the tag "NETI", 4 reserved bytes and the offset of each game on 8 bytes.
+ * A 24-byte trailer ends the file: the offset of the index, the number of
+ * games and the magic "NETA" again (plus 4 reserved bytes). Games can thus be
+ * read in order from a stream, or at random through the index.
+ */
+
+#define BINARY_MAGIC "NETB"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_SIZE 16
+#define BINARY_WRAPPING 0x01
+
+#define ARCHIVE_MAGIC "NETA"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 8
+#define ARCHIVE_INDEX_TAG "NETI"
+#define ARCHIVE_INDEX_HEADER_SIZE 8
+#define ARCHIVE_TRAILER_SIZE 24
+
+/* ************************************************************************** */
+
+static void _put_u32(uint8_t* p, uint32_t x) {
+    for (uint k = 0; k < 4; k++) p[k] = x >> (8 * k);
+}
+
+static uint32_t _get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void _put_u64(uint8_t* p, uint64_t x) {
+    for (uint k = 0; k < 8; k++) p[k] = x >> (8 * k);
+}
+
+static uint64_t _get_u64(const uint8_t* p) {
+    uint64_t x = 0;
+    for (uint k = 0; k < 8; k++) x |= (uint64_t)p[k] << (8 * k);
+    return x;
+}
+
+/** size of the binary image of a game */
+static size_t _encoded_size(cgame g) { return BINARY_HEADER_SIZE + (size_t)game_nb_rows(g) * game_nb_cols(g); }
+
+/** writes the binary image of a game (_encoded_size bytes) */
+static void _encode(cgame g, uint8_t* buf) {
+    uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+    memset(buf, 0, BINARY_HEADER_SIZE);
+    memcpy(buf, BINARY_MAGIC, 4);
+    buf[4] = BINARY_VERSION;
+    buf[5] = game_is_wrapping(g) ? BINARY_WRAPPING : 0;
+    _put_u32(buf + 8, nb_rows);
+    _put_u32(buf + 12, nb_cols);
+    // the cells are stored in the same encoding as in memory
+    memcpy(buf + BINARY_HEADER_SIZE, g->cells, (size_t)nb_rows * nb_cols);
+}
+
+/** builds a game from the bytes of a binary file (NULL if they are invalid) */
+static game _decode(const uint8_t* data, size_t len) {
+    if (len < BINARY_HEADER_SIZE || memcmp(data, BINARY_MAGIC, 4) != 0 || data[4] != BINARY_VERSION) return NULL;
+    uint nb_rows = _get_u32(data + 8), nb_cols = _get_u32(data + 12);
+    if (nb_rows == 0 || nb_cols == 0 || (uint64_t)nb_rows * nb_cols != len - BINARY_HEADER_SIZE) return NULL;
+    size_t size = (size_t)nb_rows * nb_cols;
+    const uint8_t* cells = data + BINARY_HEADER_SIZE;
+    for (size_t sq = 0; sq < size; sq++)
+        if (game_cell_shape(cells[sq]) >= NB_SHAPES) return NULL;
+    // the cells are copied as they are
+    game g = game_new_empty_ext(nb_rows, nb_cols, data[5] & BINARY_WRAPPING);
+    memcpy(g->cells, cells, size);
+    _game_rebuild(g);
+    return g;
+}
+
+/* ************************************************************************** */
+
+game game_load_binary(const char* filename) {
+    assert(filename);
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: unable to open %s\n", filename);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    size_t len = st.st_size;
+    game g = NULL;
+    void* data = len > 0 ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (data != MAP_FAILED) {
+        g = _decode(data, len);
+        munmap(data, len);
+    } else if (len > 0) {
+        // not mappable: read the whole file instead
+        uint8_t* buf = malloc(len);
+        if (!buf) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t done = 0;
+        ssize_t n = 1;
+        while (done < len && (n = read(fd, buf + done, len - done)) > 0) done += n;
+        if (done == len) g = _decode(buf, len);
+        free(buf);
+    }
+    close(fd);
+    if (!g) fprintf(stderr, "Error: invalid binary game file %s\n", filename);
+    return g;
+}
+
+void game_save_binary(cgame g, const char* filename) {
+    assert(g && filename);
+    size_t len = _encoded_size(g);
+    uint8_t* buf = malloc(len);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    _encode(g, buf);
+
+    FILE* f = fopen(filename, "wb");
+    if (!f || fwrite(buf, 1, len, f) != len) {
+        fprintf(stderr, "Error: unable to write %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+    free(buf);
+}
+
+static bool _has_extension(const char* filename, const char* ext) {
+    size_t len = strlen(filename), len_ext = strlen(ext);
+    return len >= len_ext && strcmp(filename + len - len_ext, ext) == 0;
+}
+
+bool game_is_binary_filename(const char* filename) {
+    assert(filename);
+    return _has_extension(filename, GAME_BINARY_EXT);
+}
+
+bool game_is_archive_filename(const char* filename) {
+    assert(filename);
+    return _has_extension(filename, GAME_ARCHIVE_EXT);
+}
+
+/* ************************************************************************** */
+
+struct game_archive_s {
+    bool writing;
+    FILE* file;          // output of a writer, or input of a reader that cannot be mapped
+    const uint8_t* data; // mapped reader (NULL otherwise)
+    size_t len;
+    uint64_t index;      // reader: offset of the index
+    uint64_t nb_games;
+    uint64_t next;       // reader: offset of the next game read in order
+    uint64_t nb_read;    // reader: number of games read in order
+    bool error;          // reader: a game read in order was invalid or truncated
+    uint64_t* offsets;   // writer: offset of each game
+    uint64_t capacity;
+    uint64_t end;        // writer: offset where the next game goes
+    uint8_t* buf;        // encoding or decoding buffer
+    size_t buf_size;
+};
+
+static game_archive _archive_new(bool writing) {
+    game_archive a = calloc(1, sizeof(struct game_archive_s));
+    if (!a) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    a->writing = writing;
+    return a;
+}
+
+static uint8_t* _archive_buffer(game_archive a, size_t size) {
+    if (size > a->buf_size) {
+        uint8_t* buf = realloc(a->buf, size);
+        if (!buf) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        a->buf = buf;
+        a->buf_size = size;
+    }
+    return a->buf;
+}
+
+/** checks the header, the trailer and the index of a whole archive in memory */
+static bool _archive_check(const uint8_t* data, size_t len, uint64_t* index, uint64_t* nb_games) {
+    if (len < ARCHIVE_HEADER_SIZE + ARCHIVE_INDEX_HEADER_SIZE + ARCHIVE_TRAILER_SIZE) return false;
+    if (memcmp(data, ARCHIVE_MAGIC, 4) != 0 || data[4] != ARCHIVE_VERSION) return false;
+    const uint8_t* trailer = data + len - ARCHIVE_TRAILER_SIZE;
+    if (memcmp(trailer + 16, ARCHIVE_MAGIC, 4) != 0) return false;
+    *index = _get_u64(trailer);
+    *nb_games = _get_u64(trailer + 8);
+    // no sum of values read from the file, which could wrap around
+    size_t max_index = len - ARCHIVE_TRAILER_SIZE - ARCHIVE_INDEX_HEADER_SIZE;
+    if (*index < ARCHIVE_HEADER_SIZE || *index > max_index || *nb_games != (max_index - *index) / 8 ||
+        (max_index - *index) % 8 != 0)
+        return false;
+    return memcmp(data + *index, ARCHIVE_INDEX_TAG, 4) == 0;
+}
+
+/** opens an archive for reading: mapped if possible, as a stream otherwise */
+static game_archive _archive_open_read(const char* filename) {
+    bool is_stdin = strcmp(filename, "-") == 0;
+    int fd = is_stdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: unable to open %s\n", filename);
+        if (fd >= 0 && !is_stdin) close(fd);
+        return NULL;
+    }
+    game_archive a = _archive_new(false);
+    void* data = S_ISREG(st.st_mode) && st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (data != MAP_FAILED) {
+        if (!is_stdin) close(fd);
+        a->data = data;
+        a->len = st.st_size;
+        if (!_archive_check(a->data, a->len, &a->index, &a->nb_games)) {
+            fprintf(stderr, "Error: invalid archive %s\n", filename);
+            game_archive_close(a);
+            return NULL;
+        }
+    } else {
+        a->file = is_stdin ? stdin : fdopen(fd, "rb");
+        if (!a->file) close(fd);
+        uint8_t header[ARCHIVE_HEADER_SIZE];
+        if (!a->file || fread(header, 1, ARCHIVE_HEADER_SIZE, a->file) != ARCHIVE_HEADER_SIZE ||
+            memcmp(header, ARCHIVE_MAGIC, 4) != 0 || header[4] != ARCHIVE_VERSION) {
+            fprintf(stderr, "Error: invalid archive %s\n", filename);
+            game_archive_close(a);
+            return NULL;
+        }
+    }
+    a->next = ARCHIVE_HEADER_SIZE;
+    return a;
+}
+
+/** opens an archive for writing, after the games of an existing archive */
+static game_archive _archive_open_write(const char* filename) {
+    game_archive a = _archive_new(true);
+    if (strcmp(filename, "-") == 0) {
+        a->file = stdout;
+    } else {
+        a->file = fopen(filename, "r+b");
+        if (a->file) {
+            // existing archive: read its index, then overwrite it with the new games
+            game_archive old = _archive_open_read(filename);
+            if (!old) {
+                game_archive_close(a);
+                return NULL;
+            }
+            a->nb_games = a->capacity = old->nb_games;
+            a->offsets = malloc((a->capacity ? a->capacity : 1) * sizeof(uint64_t));
+            if (!a->offsets) {
+                fprintf(stderr, "Memory allocation error\n");
+                exit(EXIT_FAILURE);
+            }
+            for (uint64_t k = 0; k < old->nb_games; k++)
+                a->offsets[k] = _get_u64(old->data + old->index + ARCHIVE_INDEX_HEADER_SIZE + 8 * k);
+            a->end = old->index;
+            game_archive_close(old);
+            if (fseek(a->file, a->end, SEEK_SET) != 0) {
+                fprintf(stderr, "Error: unable to write %s\n", filename);
+                game_archive_close(a);
+                return NULL;
+            }
+            return a;
+        }
+        a->file = fopen(filename, "wb");
+    }
+    uint8_t header[ARCHIVE_HEADER_SIZE] = {0};
+    memcpy(header, ARCHIVE_MAGIC, 4);
+    header[4] = ARCHIVE_VERSION;
+    if (!a->file || fwrite(header, 1, ARCHIVE_HEADER_SIZE, a->file) != ARCHIVE_HEADER_SIZE) {
+        fprintf(stderr, "Error: unable to write %s\n", filename);
+        game_archive_close(a);
+        return NULL;
+    }
+    a->end = ARCHIVE_HEADER_SIZE;
+    return a;
+}
+
+game_archive game_archive_open(const char* filename, bool write) {
+    assert(filename);
+    return write ? _archive_open_write(filename) : _archive_open_read(filename);
+}
+
+uint64_t game_archive_nb_games(game_archive a) {
+    assert(a);
+    return a->nb_games;
+}
+
+/** decodes the game at a given offset of a mapped archive (NULL if invalid) */
+static game _archive_decode(game_archive a, uint64_t offset, uint64_t* end) {
+    if (a->index < BINARY_HEADER_SIZE || offset > a->index - BINARY_HEADER_SIZE) return NULL;
+    const uint8_t* p = a->data + offset;
+    uint64_t size = BINARY_HEADER_SIZE + (uint64_t)_get_u32(p + 8) * _get_u32(p + 12);
+    if (size > a->index - offset) return NULL;
+    *end = offset + size;
+    return _decode(p, size);
+}
+
+game game_archive_get(game_archive a, uint64_t k) {
+    assert(a);
+    if (a->writing || !a->data || k >= a->nb_games) return NULL;
+    uint64_t end;
+    return _archive_decode(a, _get_u64(a->data + a->index + ARCHIVE_INDEX_HEADER_SIZE + 8 * k), &end);
+}
+
+/** stops reading in order after an invalid game */
+static game _archive_fail(game_archive a) {
+    a->error = true;
+    if (a->data) a->next = a->index;
+    return NULL;
+}
+
+game game_archive_next(game_archive a) {
+    assert(a);
+    if (a->writing || a->error) return NULL;
+    if (a->data) {
+        // in order through the mapped games, up to the index
+        if (a->next >= a->index) {
+            // the games must end exactly where the index starts
+            if (a->nb_read != a->nb_games) return _archive_fail(a);
+            return NULL;
+        }
+        game g = _archive_decode(a, a->next, &a->next);
+        if (!g) return _archive_fail(a);
+        a->nb_read++;
+        return g;
+    }
+    // stream: games follow each other until the index tag
+    uint8_t header[BINARY_HEADER_SIZE];
+    size_t n = fread(header, 1, BINARY_HEADER_SIZE, a->file);
+    if (n == 0 && feof(a->file)) return NULL; // no index: a truncated stream ends on a game
+    if (n >= 4 && memcmp(header, ARCHIVE_INDEX_TAG, 4) == 0) return NULL;
+    if (n != BINARY_HEADER_SIZE || memcmp(header, BINARY_MAGIC, 4) != 0) return _archive_fail(a);
+    uint64_t size = BINARY_HEADER_SIZE + (uint64_t)_get_u32(header + 8) * _get_u32(header + 12);
+    if (size > SIZE_MAX) return _archive_fail(a);
+    uint8_t* buf = _archive_buffer(a, size);
+    memcpy(buf, header, BINARY_HEADER_SIZE);
+    if (fread(buf + BINARY_HEADER_SIZE, 1, size - BINARY_HEADER_SIZE, a->file) != size - BINARY_HEADER_SIZE)
+        return _archive_fail(a);
+    game g = _decode(buf, size);
+    if (!g) return _archive_fail(a);
+    a->nb_games++;
+    a->nb_read++;
+    return g;
+}
+
+bool game_archive_error(game_archive a) {
+    assert(a);
+    return a->error;
+}
+
+bool game_archive_append(game_archive a, cgame g) {
+    assert(a && g);
+    if (!a->writing) return false;
+    if (a->nb_games == a->capacity) {
+        uint64_t capacity = a->capacity ? 2 * a->capacity : 64;
+        uint64_t* offsets = realloc(a->offsets, capacity * sizeof(uint64_t));
+        if (!offsets) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        a->offsets = offsets;
+        a->capacity = capacity;
+    }
+    size_t size = _encoded_size(g);
+    uint8_t* buf = _archive_buffer(a, size);
+    _encode(g, buf);
+    if (fwrite(buf, 1, size, a->file) != size) return false;
+    a->offsets[a->nb_games++] = a->end;
+    a->end += size;
+    return true;
+}
+
+bool game_archive_close(game_archive a) {
+    if (!a) return true;
+    bool ok = true;
+    if (a->writing && a->file) {
+        uint8_t entry[ARCHIVE_TRAILER_SIZE] = {0};
+        memcpy(entry, ARCHIVE_INDEX_TAG, 4);
+        ok = fwrite(entry, 1, ARCHIVE_INDEX_HEADER_SIZE, a->file) == ARCHIVE_INDEX_HEADER_SIZE;
+        for (uint64_t k = 0; k < a->nb_games && ok; k++) {
+            _put_u64(entry, a->offsets[k]);
+            ok = fwrite(entry, 1, 8, a->file) == 8;
+        }
+        _put_u64(entry, a->end);
+        _put_u64(entry + 8, a->nb_games);
+        memcpy(entry + 16, ARCHIVE_MAGIC, 4);
+        memset(entry + 20, 0, 4);
+        ok = ok && fwrite(entry, 1, ARCHIVE_TRAILER_SIZE, a->file) == ARCHIVE_TRAILER_SIZE;
+    }
+    if (a->file && a->file != stdout && a->file != stdin) ok = fclose(a->file) == 0 && ok;
+    else if (a->file == stdout) ok = fflush(stdout) == 0 && ok;
+    if (a->data) munmap((void*)a->data, a->len);
+    free(a->offsets);
+    free(a->buf);
+    free(a);
+    return ok;
+}
@@ -2,7 +2,6 @@
 #include "game.h"
 #include "game_aux.h"
 #include "game_struct.h"
-#include "queue/queue.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,7 +15,7 @@ game game_new_ext(uint nb_rows, uint nb_cols, shape* shapes, direction* orientat
                 fprintf(stderr, "The size of the shapes array is invalid\n");
                 exit(EXIT_FAILURE);
             }
-            g->s[i] = shapes[i];
+            g->cells[i] = shapes[i] << 2 | (g->cells[i] & 3);
         }
     }
     if (orientations != NULL) {
@@ -25,9 +24,10 @@ game game_new_ext(uint nb_rows, uint nb_cols, shape* shapes, direction* orientat
                 fprintf(stderr, "The size of the orientations array is invalid\n");
                 exit(EXIT_FAILURE);
             }
-            g->d[i] = orientations[i];
+            g->cells[i] = (g->cells[i] & ~3) | orientations[i];
         }
     }
+    _game_rebuild(g);
     return g;
 }
 
@@ -37,41 +37,12 @@ game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping) {
         return NULL;
     }
 
-    // Allocate memory for the game structure
-    game g = malloc(sizeof(game_s));
+    // Allocate the structure and the grid (empty squares facing north) at once
+    game g = _game_alloc(nb_rows, nb_cols, wrapping);
     if (!g) {
         fprintf(stderr, "Error: memory allocation failed in game_new_empty_ext\n");
         exit(EXIT_FAILURE);
     }
-
-    uint size = (nb_rows * nb_cols);
-
-    // Initialize game fields
-    g->nb_rows = nb_rows;
-    g->nb_columns = nb_cols;
-    g->wrapping = wrapping;
-    g->undo_stack = queue_new();
-    g->redo_stack = queue_new();
-
-    // Allocate memory for shapes and orientations
-    g->s = calloc(size, sizeof(shape));
-    g->d = calloc(size, sizeof(direction));
-
-    if (!g->s || !g->d) {
-        free(g->s);
-        free(g->d);
-        queue_free(g->undo_stack);
-        queue_free(g->redo_stack);
-        free(g);
-        fprintf(stderr, "Error: memory allocation failed for shapes or orientations\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Initialize the grid with default values
-    for (uint i = 0; i < size; i++) {
-        g->s[i] = EMPTY;
-        g->d[i] = NORTH;
-    }
     return g;
 }
 
@@ -104,24 +75,18 @@ void game_undo(game g) {
         fprintf(stderr, "Invalid game\n");
         exit(EXIT_FAILURE);
     }
-    if (!queue_is_empty(g->undo_stack)) {
-        // The type of data is an array of integers
-        int* last_move = queue_pop_tail(g->undo_stack);
-        // Push it to the redo stack
-        queue_push_tail(g->redo_stack, last_move);
-
-        int i = last_move[0];
-        int j = last_move[1];
-        int nb_quarter_turns = last_move[2];
-
-        int reverse_rotations = (nb_quarter_turns % 4 + 4) % 4;
-        for (int k = 0; k < reverse_rotations; k++) {
-            if (g->d[i * game_nb_cols(g) + j] == NORTH) {
-                g->d[i * game_nb_cols(g) + j] = WEST;
-            } else {
-                g->d[i * game_nb_cols(g) + j] -= 1;
-            }
-        }
+    if (g->history.nb_undo > 0) {
+        // The last move becomes the first one of the redo stack
+        g->history.nb_undo--;
+        g->history.nb_redo++;
+        uint32_t last_move = *_game_history_at(g, g->history.nb_undo);
+
+        uint index = HISTORY_INDEX(last_move);
+        uint i = index / g->nb_columns;
+        uint j = index % g->nb_columns;
+        int reverse_rotations = HISTORY_TURNS(last_move);
+        _game_set_square(g, i, j, _game_shape(g, index), (_game_orientation(g, index) + NB_DIRS - reverse_rotations) % NB_DIRS);
+        _game_update_won(g);
     } else {
         printf("No move to undo.\n");
     }
@@ -132,25 +97,53 @@ void game_redo(game g) {
         fprintf(stderr, "Invalid game\n");
         exit(EXIT_FAILURE);
     }
-    if (!queue_is_empty(g->redo_stack)) {
-        // The type of data is an array of integers
-        int* last_move = queue_pop_tail(g->redo_stack);
-        // Push it to the undo stack
-        queue_push_tail(g->undo_stack, last_move);
-
-        int i = last_move[0];
-        int j = last_move[1];
-        int nb_quarter_turns = last_move[2];
-
-        int rotations = (nb_quarter_turns % 4 + 4) % 4;
-        for (int k = 0; k < rotations; k++) {
-            if (g->d[i * game_nb_cols(g) + j] == WEST) {
-                g->d[i * game_nb_cols(g) + j] = NORTH;
-            } else {
-                g->d[i * game_nb_cols(g) + j] += 1;
-            }
-        }
+    if (g->history.nb_redo > 0) {
+        // The last cancelled move goes back to the undo stack
+        uint32_t last_move = *_game_history_at(g, g->history.nb_undo);
+        g->history.nb_undo++;
+        g->history.nb_redo--;
+
+        uint index = HISTORY_INDEX(last_move);
+        uint i = index / g->nb_columns;
+        uint j = index % g->nb_columns;
+        int rotations = HISTORY_TURNS(last_move);
+        _game_set_square(g, i, j, _game_shape(g, index), (_game_orientation(g, index) + rotations) % NB_DIRS);
+        _game_update_won(g);
     } else {
         printf("No move to redo.\n");
     }
 }
+
+void game_set_history_depth(game g, uint max_depth) {
+    if (!g) {
+        fprintf(stderr, "Invalid game\n");
+        exit(EXIT_FAILURE);
+    }
+    g->history.policy.max_moves = max_depth;
+    _game_history_fit(g);
+}
+
+void game_set_history_policy(game g, const game_history_policy* policy) {
+    if (!g || !policy) {
+        fprintf(stderr, "Invalid game or policy\n");
+        exit(EXIT_FAILURE);
+    }
+    g->history.policy = *policy;
+    _game_history_fit(g);
+}
+
+game_history_policy game_get_history_policy(cgame g) {
+    if (!g) {
+        fprintf(stderr, "Invalid game\n");
+        exit(EXIT_FAILURE);
+    }
+    return g->history.policy;
+}
+
+size_t game_history_memory(cgame g) {
+    if (!g) {
+        fprintf(stderr, "Invalid game\n");
+        exit(EXIT_FAILURE);
+    }
+    return g->history.capacity * sizeof(uint32_t);
+}
@@ -9,8 +9,10 @@
 #define __GAME_EXT_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "game.h"
+#include "game_rng.h"
 
 /**
  * @name Extended Functions
@@ -92,6 +94,80 @@ void game_undo(game g);
  **/
 void game_redo(game g);
 
+/**
+ * @brief Policy of the history of the moves.
+ * @details By default, every move is kept.
+ **/
+typedef struct {
+    bool coalesce;    /**< consecutive rotations of a square make a single move (none after a full turn) */
+    uint max_moves;   /**< maximum number of moves that can be undone (0: no limit) */
+    size_t max_bytes; /**< maximum size of the history buffer (0: no limit), at least one move is kept */
+} game_history_policy;
+
+/**
+ * @brief Sets the policy of the history of the moves.
+ * @details When the history is full, playing a move forgets the oldest one.
+ * With coalescing, undoing a move cancels all the consecutive rotations of its
+ * square, and redoing it replays them. The history is trimmed to a new policy
+ * at once (oldest moves first, then the cancelled moves beyond max_bytes).
+ * @param g the game
+ * @param policy the new policy
+ * @pre @p g is a valid pointer toward a game structure
+ * @pre @p policy is a valid pointer
+ **/
+void game_set_history_policy(game g, const game_history_policy* policy);
+
+/**
+ * @brief Gets the policy of the history of the moves.
+ * @param g the game
+ * @return the current policy
+ * @pre @p g is a valid pointer toward a game structure
+ **/
+game_history_policy game_get_history_policy(cgame g);
+
+/**
+ * @brief Sets the maximum number of moves that can be undone.
+ * @details Shorthand for the max_moves field of @ref game_set_history_policy.
+ * @param g the game
+ * @param max_depth the maximum number of moves in the history (0: no limit, the
+ * default)
+ * @pre @p g is a valid pointer toward a game structure
+ **/
+void game_set_history_depth(game g, uint max_depth);
+
+/**
+ * @brief Memory used by the history of the moves.
+ * @details Each move takes 4 bytes in a buffer shared by @ref game_undo and
+ * @ref game_redo, whose size is doubled when it is full.
+ * @param g the game
+ * @return the size of the history buffer, in bytes
+ * @pre @p g is a valid pointer toward a game structure
+ **/
+size_t game_history_memory(cgame g);
+
+/**
+ * @brief Shuffles the orientation of every piece with a given generator.
+ * @details Reentrant version of @ref game_shuffle_orientation, which uses a
+ * generator seeded from rand().
+ * @param g the game
+ * @param rng the random number generator
+ * @pre @p g is a valid pointer toward a game structure
+ * @pre @p rng is a seeded generator
+ **/
+void game_shuffle_orientation_r(game g, game_rng* rng);
+
+/**
+ * @brief Copies a game into an existing one.
+ * @details The grid, its size and the wrapping option are copied, and the
+ * history of @p dst is cleared. The storage of @p dst is reused when it is
+ * large enough, so copying games of the same size never allocates; it is only
+ * reallocated when the grid grows.
+ * @param dst the game to overwrite
+ * @param src the game to copy
+ * @pre @p dst and @p src are valid pointers toward game structures
+ **/
+void game_copy_into(game dst, cgame src);
+
 /**
  * @}
  */
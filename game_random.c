@@ -1,32 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
 #include "game_tools.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+
+/** @brief Parameters of the generated games. */
+typedef struct {
+    uint nb_rows;
+    uint nb_cols;
+    bool wrapping;
+    uint nb_empty;
+    uint nb_extra;
+    bool shuffle;
+    bool unique;
+} params;
+
+/**
+ * @brief Bulk generation shared by all the workers.
+ * @details Game k is generated from its own seed, so the output does not depend
+ * on the number of threads. In a single file or an archive, games are written
+ * in order: a worker waits for its turn before writing.
+ */
+typedef struct {
+    const params* p;
+    uint64_t seed;
+    uint count;
+    FILE* out;            // single output file, or NULL
+    game_archive archive; // output archive, or NULL
+    const char* dir;      // output directory, or NULL
+    pthread_mutex_t lock;
+    pthread_cond_t turn;
+    uint next_game;    // next game to generate
+    uint next_written; // next game to write in the file
+    uint nb_failed;
+} bulk;
+
+/* ************************************************************************** */
+
+void usage(char* argv[]) {
+    fprintf(stderr, "Usage %s [options] <nb_rows> <nb_cols> <wrapping> <nb_empty> <nb_extra> <shuffle> [<filename>]\n", argv[0]);
+    fprintf(stderr, "Example: %s 4 4 0 0 0 0 random.sol\n", argv[0]);
+    fprintf(stderr, "  --unique: the puzzle has a single solution\n");
+    fprintf(stderr, "  --seed <seed>: seed of the generator (default: a new seed per run, printed on stderr)\n");
+    fprintf(stderr, "  --count <count>: generate count games into <filename> (a file, an archive or a directory, default: stdout)\n");
+    fprintf(stderr, "  --jobs <jobs>: number of threads used with --count (default: number of CPUs)\n");
+    exit(EXIT_FAILURE);
+}
+
+static double _now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Seed used without --seed.
+ * @details time(NULL) gives the same puzzle to every run started in the same
+ * second, so read /dev/urandom, or mix the clock nanoseconds with the process id
+ * if it is not available.
+ */
+static uint64_t _default_seed(void) {
+    uint64_t seed = 0;
+    FILE* f = fopen("/dev/urandom", "rb");
+    if (f) {
+        size_t n = fread(&seed, sizeof(seed), 1, f);
+        fclose(f);
+        if (n == 1) return seed;
+    }
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    seed = (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+    return seed ^ ((uint64_t)getpid() * 0x9e3779b97f4a7c15ULL);
+}
+
+/** generates game k of the seed (NULL if no unique game has been found) */
+static game _generate(const params* p, uint64_t seed, uint k, game_random_stats* stats) {
+    // each game has its own stream (the odd multiplier spreads consecutive games)
+    game_rng rng;
+    game_rng_seed(&rng, seed + k * 0xd1342543de82ef95ULL);
+    game g;
+    if (p->unique) {
+        g = game_random_unique_r(p->nb_rows, p->nb_cols, p->wrapping, p->nb_empty, p->nb_extra, stats, &rng);
+    } else {
+        g = game_random_r(p->nb_rows, p->nb_cols, p->wrapping, p->nb_empty, p->nb_extra, &rng);
+    }
+    if (g && p->shuffle) game_shuffle_orientation_r(g, &rng);
+    return g;
+}
+
+/* ************************************************************************** */
+
+static void* _bulk_run(void* arg) {
+    bulk* b = arg;
+    pthread_mutex_lock(&b->lock);
+    while (b->next_game < b->count) {
+        uint k = b->next_game++;
+        pthread_mutex_unlock(&b->lock);
+        game g = _generate(b->p, b->seed, k, NULL);
+
+        if (b->dir && g) {
+            char filename[4096];
+            snprintf(filename, sizeof(filename), "%s/%08u.txt", b->dir, k);
+            game_save(g, filename);
+        }
+
+        pthread_mutex_lock(&b->lock);
+        if (!g) b->nb_failed++;
+        if (b->out || b->archive) {
+            while (b->next_written != k) pthread_cond_wait(&b->turn, &b->lock);
+            if (g && b->out) game_write(g, b->out);
+            if (g && b->archive && !game_archive_append(b->archive, g)) b->nb_failed++;
+            b->next_written++;
+            pthread_cond_broadcast(&b->turn);
+        }
+        if (g) game_delete(g);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+static int _bulk_generate(const params* p, uint64_t seed, uint count, uint nb_jobs, const char* filename) {
+    bulk b = {.p = p, .seed = seed, .count = count, .out = stdout, .dir = NULL};
+    struct stat st;
+    if (filename && stat(filename, &st) == 0 && S_ISDIR(st.st_mode)) {
+        b.out = NULL;
+        b.dir = filename;
+    } else if (filename && game_is_archive_filename(filename)) {
+        b.out = NULL;
+        b.archive = game_archive_open(filename, true);
+        if (!b.archive) return EXIT_FAILURE;
+    } else if (filename) {
+        b.out = fopen(filename, "w");
+        if (!b.out) {
+            fprintf(stderr, "Error: unable to open %s\n", filename);
+            return EXIT_FAILURE;
+        }
+    }
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.turn, NULL);
+    pthread_t* threads = malloc(nb_jobs * sizeof(pthread_t));
+    if (!threads) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double start = _now();
+    uint nb_threads = 0;
+    for (; nb_threads < nb_jobs; nb_threads++)
+        if (pthread_create(&threads[nb_threads], NULL, _bulk_run, &b) != 0) break;
+    if (nb_threads == 0) _bulk_run(&b);
+    for (uint t = 0; t < nb_threads; t++) pthread_join(threads[t], NULL);
+    double time = _now() - start;
+
+    free(threads);
+    pthread_cond_destroy(&b.turn);
+    pthread_mutex_destroy(&b.lock);
+    if (b.out && b.out != stdout) fclose(b.out);
+    else if (b.out) fflush(stdout);
+    if (b.archive && !game_archive_close(b.archive)) {
+        fprintf(stderr, "Error: unable to write %s\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    uint nb = count - b.nb_failed;
+    fprintf(stderr, "%u games in %.3f s (%.1f games/s), %u thread(s), seed %" PRIu64 "\n", nb, time, time > 0 ? nb / time : 0.0,
+            nb_threads > 0 ? nb_threads : 1, seed);
+    if (b.nb_failed > 0) {
+        fprintf(stderr, "Error: %u game(s) not generated or not written\n", b.nb_failed);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
 
 int main(int argc, char* argv[]) {
-    srand(time(NULL));
-    if (argc != 7 && argc != 8) {
-        fprintf(stderr, "Usage ./game_random <nb_rows> <nb_cols> <wrapping> <nb_empty> <nb_extra> <shuffle> [<filename>]\n");
-        fprintf(stderr, "Example: ./game_random 4 4 0 0 0 0 random.sol\n");
+    uint64_t seed = 0;
+    bool has_seed = false;
+    uint count = 0;
+    long nb_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    params p = {.unique = false};
+    // options may appear anywhere, the other arguments are positional
+    int nb_args = 1;
+    for (int k = 1; k < argc; k++) {
+        if (strcmp(argv[k], "--unique") == 0) {
+            p.unique = true;
+        } else if (strcmp(argv[k], "--seed") == 0 && k + 1 < argc) {
+            seed = strtoull(argv[++k], NULL, 10);
+            has_seed = true;
+        } else if (strcmp(argv[k], "--count") == 0 && k + 1 < argc) {
+            count = strtoul(argv[++k], NULL, 10);
+            if (count == 0) usage(argv);
+        } else if (strcmp(argv[k], "--jobs") == 0 && k + 1 < argc) {
+            nb_jobs = strtol(argv[++k], NULL, 10);
+            if (nb_jobs <= 0) usage(argv);
+        } else {
+            argv[nb_args++] = argv[k];
+        }
+    }
+    argc = nb_args;
+    if (argc != 7 && argc != 8) usage(argv);
+    p.nb_rows = strtoul(argv[1], NULL, 10);
+    p.nb_cols = strtoul(argv[2], NULL, 10);
+    p.wrapping = strtoul(argv[3], NULL, 10);
+    p.nb_empty = strtoul(argv[4], NULL, 10);
+    p.nb_extra = strtoul(argv[5], NULL, 10);
+    p.shuffle = strtoul(argv[6], NULL, 10);
+    if (nb_jobs <= 0) nb_jobs = 1;
+    if (!has_seed) seed = _default_seed();
+    if (count > 0) return _bulk_generate(&p, seed, count, nb_jobs, argc == 8 ? argv[7] : NULL);
+
+    game_random_stats stats;
+    game g = _generate(&p, seed, 0, &stats);
+    fprintf(stderr, "seed %" PRIu64 "\n", seed);
+    if (!g) {
+        fprintf(stderr, "Error: no puzzle with a single solution found after %u attempts\n", stats.nb_attempts);
         return EXIT_FAILURE;
     }
-    game g = game_random(strtoul(argv[1], NULL, 10), strtoul(argv[2], NULL, 10), strtoul(argv[3], NULL, 10), strtoul(argv[4], NULL, 10), strtoul(argv[5], NULL, 10));
+    if (p.unique) printf("unique: %u attempt(s), %u fix(es), %.3f s\n", stats.nb_attempts, stats.nb_fixes, stats.time);
     printf("nb_rows: %u ", game_nb_rows(g));
     printf("nb_cols: %u ", game_nb_cols(g));
     printf("wrapping: %d\n", game_is_wrapping(g));
-    printf("nb_empty: %lu ", strtoul(argv[4], NULL, 10));
-    printf("nb_extra: %lu ", strtoul(argv[5], NULL, 10));
-    printf("shuffle: %lu\n", strtoul(argv[6], NULL, 10));
-    if (strtoul(argv[6], NULL, 10)) {
-        game_shuffle_orientation(g);
-    }
-    if (argc == 8) {
+    printf("nb_empty: %u ", p.nb_empty);
+    printf("nb_extra: %u ", p.nb_extra);
+    printf("shuffle: %d\n", p.shuffle);
+    if (argc == 8 && game_is_archive_filename(argv[7])) {
+        game_archive a = game_archive_open(argv[7], true);
+        bool ok = a && game_archive_append(a, g);
+        if (!game_archive_close(a) || !ok) return EXIT_FAILURE;
+    } else if (argc == 8) {
         game_save(g, argv[7]);
     }
     game_print(g);
     game_delete(g);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,42 @@
+#include "game_rng.h"
+#include <assert.h>
+#include <stdint.h>
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+static uint64_t _rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+void game_rng_seed(game_rng* rng, uint64_t seed) {
+    assert(rng);
+    // splitmix64, which never gives an all-zero state
+    for (int k = 0; k < 4; k++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        rng->s[k] = z ^ (z >> 31);
+    }
+}
+
+uint64_t game_rng_next(game_rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = _rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _rotl(s[3], 45);
+    return result;
+}
+
+uint32_t game_rng_below(game_rng* rng, uint32_t n) {
+    assert(n > 0);
+    // multiply-shift with rejection of the biased low products (Lemire)
+    uint64_t m = (game_rng_next(rng) >> 32) * n;
+    if ((uint32_t)m < n) {
+        uint32_t threshold = -n % n;
+        while ((uint32_t)m < threshold) m = (game_rng_next(rng) >> 32) * n;
+    }
+    return m >> 32;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file game_rng.h
+ * @brief Reentrant Random Number Generator.
+ * @details A xoshiro256** generator whose whole state is held by the caller,
+ * so that several threads can generate games at the same time, each with its
+ * own reproducible stream, without sharing the libc rand() state.
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#ifndef __GAME_RNG_H__
+#define __GAME_RNG_H__
+
+#include <stdint.h>
+
+/**
+ * @brief State of a random number generator.
+ * @details Must be initialized with game_rng_seed before use.
+ **/
+typedef struct {
+    uint64_t s[4];
+} game_rng;
+
+/**
+ * @brief Initializes a generator from a seed.
+ * @details The four words of the state are expanded from the seed with
+ * splitmix64, so that close seeds still give unrelated streams.
+ * @param rng the generator
+ * @param seed any 64-bit value
+ **/
+void game_rng_seed(game_rng* rng, uint64_t seed);
+
+/**
+ * @brief Gets the next 64-bit random value.
+ * @param rng the generator
+ * @return a uniformly distributed 64-bit value
+ **/
+uint64_t game_rng_next(game_rng* rng);
+
+/**
+ * @brief Gets a random integer below a bound, without modulo bias.
+ * @param rng the generator
+ * @param n the bound
+ * @pre n > 0
+ * @return a uniformly distributed integer in [0, n)
+ **/
+uint32_t game_rng_below(game_rng* rng, uint32_t n);
+
+#endif // __GAME_RNG_H__
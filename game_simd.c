@@ -0,0 +1,203 @@
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_struct.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GAME_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+/* ************************************************************************** */
+
+/**
+ * @brief Word kernels used to compare two half-edge planes.
+ * @details xor_count returns the number of bits that differ between a[0..n-1]
+ * and b[0..n-1]. shift_count compares the east bits of words 0..n-2 of a row
+ * with the west bits of the same row shifted by one column (the last word,
+ * which has unused bits, is left to the caller).
+ */
+typedef struct {
+    uint (*xor_count)(const uint64_t* a, const uint64_t* b, uint n);
+    uint (*shift_count)(const uint64_t* east, const uint64_t* west, uint n);
+} edge_kernel;
+
+/* ************************************************************************** */
+
+static uint _popcount64(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    uint nb = 0;
+    for (; x; x &= x - 1) nb++;
+    return nb;
+#endif
+}
+
+static uint64_t _shifted_west(const uint64_t* west, uint k) { return (west[k] >> 1) | (west[k + 1] << 63); }
+
+static uint _xor_count_scalar(const uint64_t* a, const uint64_t* b, uint n) {
+    uint nb = 0;
+    for (uint k = 0; k < n; k++) nb += _popcount64(a[k] ^ b[k]);
+    return nb;
+}
+
+static uint _shift_count_scalar(const uint64_t* east, const uint64_t* west, uint n) {
+    uint nb = 0;
+    for (uint k = 0; k + 1 < n; k++) nb += _popcount64(east[k] ^ _shifted_west(west, k));
+    return nb;
+}
+
+/* ************************************************************************** */
+
+#ifdef GAME_SIMD_X86
+
+/** number of bits set in each 64-bit lane (SWAR, then sum of the bytes) */
+__attribute__((target("sse2"))) static __m128i _popcount_sse2(__m128i v) {
+    const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+    v = _mm_sub_epi64(v, _mm_and_si128(_mm_srli_epi64(v, 1), m1));
+    v = _mm_add_epi64(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi64(v, 2), m2));
+    v = _mm_and_si128(_mm_add_epi64(v, _mm_srli_epi64(v, 4)), m4);
+    return _mm_sad_epu8(v, _mm_setzero_si128());
+}
+
+__attribute__((target("sse2"))) static uint _sum_sse2(__m128i acc) {
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1];
+}
+
+__attribute__((target("sse2"))) static uint _xor_count_sse2(const uint64_t* a, const uint64_t* b, uint n) {
+    __m128i acc = _mm_setzero_si128();
+    uint k = 0;
+    for (; k + 2 <= n; k += 2) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + k)), _mm_loadu_si128((const __m128i*)(b + k)));
+        acc = _mm_add_epi64(acc, _popcount_sse2(v));
+    }
+    return _sum_sse2(acc) + _xor_count_scalar(a + k, b + k, n - k);
+}
+
+__attribute__((target("sse2"))) static uint _shift_count_sse2(const uint64_t* east, const uint64_t* west, uint n) {
+    __m128i acc = _mm_setzero_si128();
+    uint k = 0;
+    for (; k + 2 < n; k += 2) {
+        __m128i lo = _mm_srli_epi64(_mm_loadu_si128((const __m128i*)(west + k)), 1);
+        __m128i hi = _mm_slli_epi64(_mm_loadu_si128((const __m128i*)(west + k + 1)), 63);
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(east + k)), _mm_or_si128(lo, hi));
+        acc = _mm_add_epi64(acc, _popcount_sse2(v));
+    }
+    return _sum_sse2(acc) + _shift_count_scalar(east + k, west + k, n - k);
+}
+
+/* ************************************************************************** */
+
+__attribute__((target("avx2"))) static __m256i _popcount_avx2(__m256i v) {
+    const __m256i m1 = _mm256_set1_epi8(0x55), m2 = _mm256_set1_epi8(0x33), m4 = _mm256_set1_epi8(0x0f);
+    v = _mm256_sub_epi64(v, _mm256_and_si256(_mm256_srli_epi64(v, 1), m1));
+    v = _mm256_add_epi64(_mm256_and_si256(v, m2), _mm256_and_si256(_mm256_srli_epi64(v, 2), m2));
+    v = _mm256_and_si256(_mm256_add_epi64(v, _mm256_srli_epi64(v, 4)), m4);
+    return _mm256_sad_epu8(v, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static uint _sum_avx2(__m256i acc) {
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx2"))) static uint _xor_count_avx2(const uint64_t* a, const uint64_t* b, uint n) {
+    __m256i acc = _mm256_setzero_si256();
+    uint k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + k)), _mm256_loadu_si256((const __m256i*)(b + k)));
+        acc = _mm256_add_epi64(acc, _popcount_avx2(v));
+    }
+    return _sum_avx2(acc) + _xor_count_scalar(a + k, b + k, n - k);
+}
+
+__attribute__((target("avx2"))) static uint _shift_count_avx2(const uint64_t* east, const uint64_t* west, uint n) {
+    __m256i acc = _mm256_setzero_si256();
+    uint k = 0;
+    for (; k + 4 < n; k += 4) {
+        __m256i lo = _mm256_srli_epi64(_mm256_loadu_si256((const __m256i*)(west + k)), 1);
+        __m256i hi = _mm256_slli_epi64(_mm256_loadu_si256((const __m256i*)(west + k + 1)), 63);
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(east + k)), _mm256_or_si256(lo, hi));
+        acc = _mm256_add_epi64(acc, _popcount_avx2(v));
+    }
+    return _sum_avx2(acc) + _shift_count_scalar(east + k, west + k, n - k);
+}
+
+#endif // GAME_SIMD_X86
+
+/* ************************************************************************** */
+
+static const edge_kernel _kernels[] = {
+    {_xor_count_scalar, _shift_count_scalar},
+#ifdef GAME_SIMD_X86
+    {_xor_count_sse2, _shift_count_sse2},
+    {_xor_count_avx2, _shift_count_avx2},
+#endif
+};
+
+simd_level _game_simd_level(void) {
+#ifdef GAME_SIMD_X86
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+/* ************************************************************************** */
+
+uint _game_edge_mismatches_with(cgame g, simd_level level) {
+    simd_level best = _game_simd_level();
+    const edge_kernel* kernel = &_kernels[level < best ? level : best];
+
+    uint nb_rows = g->nb_rows, nb_cols = g->nb_columns, nb_words = g->nb_words;
+    uint last = nb_cols - 1;
+    uint64_t last_mask = (nb_cols % 64) ? ((uint64_t)1 << (nb_cols % 64)) - 1 : ~(uint64_t)0;
+    uint nb = 0;
+    for (uint i = 0; i < nb_rows; i++) {
+        const uint64_t* east = _game_plane(g, EAST, i);
+        const uint64_t* west = _game_plane(g, WEST, i);
+        const uint64_t* south = _game_plane(g, SOUTH, i);
+        const uint64_t* north = _game_plane(g, NORTH, (i + 1) % nb_rows);
+
+        // east half-edges of column j against west half-edges of column j+1
+        nb += kernel->shift_count(east, west, nb_words);
+        nb += _popcount64((east[nb_words - 1] ^ (west[nb_words - 1] >> 1)) & (last_mask >> 1));
+        // wraparound column (or border of the grid)
+        uint e = (east[last / 64] >> (last % 64)) & 1;
+        uint w = west[0] & 1;
+        nb += g->wrapping ? (e ^ w) : (e + w);
+
+        // south half-edges of row i against north half-edges of row i+1
+        if (i + 1 < nb_rows || g->wrapping) {
+            nb += kernel->xor_count(south, north, nb_words);
+        } else {
+            const uint64_t* top = _game_plane(g, NORTH, 0);
+            for (uint k = 0; k < nb_words; k++) nb += _popcount64(south[k]) + _popcount64(top[k]);
+        }
+    }
+    return nb;
+}
+
+uint _game_edge_mismatches(cgame g) { return _game_edge_mismatches_with(g, SIMD_AVX2); }
+
+/* ************************************************************************** */
+
+bool game_check_edges(cgame g, uint* nb_mismatches) {
+    if (!g) {
+        fprintf(stderr, "Invalid game\n");
+        exit(EXIT_FAILURE);
+    }
+    uint nb = _game_edge_mismatches(g);
+    if (nb_mismatches) *nb_mismatches = nb;
+    return nb == 0;
+}
@@ -1,59 +1,480 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
 #include "game_tools.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_QUEUE_DEPTH 64
+#define MAX_THREADS 1024
+#define STREAM_BLOCK (1 << 20)
+
+/** @brief Options of the command line. */
+typedef struct {
+    char mode; // 's', 'c' or 'r'
+    uint nb_threads;
+    bool sat;
+    bool verbose;
+    char* json;
+    bool batch;
+    uint queue_depth;
+} options;
 
 void usage(int argc, char* argv[]) {
-    fprintf(stderr, "Usage: %s <filename>\n", argv[0]);
+    fprintf(stderr, "Usage: %s <-s|-c|-r> <input|-> [<output>] [-j <nb_threads>] [--sat] [-v] [--json <file>]\n", argv[0]);
+    fprintf(stderr, "       %s <-s|-c|-r> --batch <input|-> [<output>] [-j <nb_workers>] [--queue <depth>] ...\n", argv[0]);
+    fprintf(stderr, "  -s: solve, -c: count the solutions, -r: rate the difficulty\n");
+    fprintf(stderr, "  an input archive (%s) is processed game by game: one line per game with -c and -r,\n", GAME_ARCHIVE_EXT);
+    fprintf(stderr, "  and with -s, the solved games go to <output> (an archive, or a text file) or to stdout,\n");
+    fprintf(stderr, "  an unsolvable game being written unchanged (and reported on stderr)\n");
+    fprintf(stderr, "  --batch: the input is a stream of games one after the other (or an archive), processed by\n");
+    fprintf(stderr, "           a pool of workers; the results are written in the input order\n");
+    fprintf(stderr, "  -j <nb_threads>: count the solutions with several threads (0 = one per processor, at most %d);\n", MAX_THREADS);
+    fprintf(stderr, "                   with --batch, number of workers\n");
+    fprintf(stderr, "  --queue <depth>: with --batch, maximum number of games in flight (default %d)\n", DEFAULT_QUEUE_DEPTH);
+    fprintf(stderr, "  --sat: solve with the SAT backend (for large wrapping games)\n");
+    fprintf(stderr, "  -v: print the statistics of the search engine on stderr (no nodes when -c needs no search)\n");
+    fprintf(stderr, "  --json <file>: append the statistics of the search engine to a JSON lines file\n");
     exit(EXIT_FAILURE);
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 3 || argc > 4) {
-        usage(argc, argv);
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void print_stats(const char* filename, const game_stats* stats, bool verbose, const char* json) {
+    // batch workers print their statistics concurrently
+    pthread_mutex_lock(&stats_lock);
+    if (verbose) {
+        game_stats_print(stderr, filename, stats, false);
+    }
+    if (json) {
+        FILE* f = fopen(json, "a");
+        if (f) {
+            game_stats_print(f, filename, stats, true);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Error: unable to open %s\n", json);
+        }
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/* ************************************************************************** */
+
+/** solves a game in place, false if it has no solution */
+static bool _solve(game g, const char* name, const options* o) {
+    bool found;
+    if (o->sat) {
+        found = game_solve_sat(g);
+    } else if (o->verbose || o->json) {
+        game_stats stats;
+        found = game_solve_stats(g, &stats);
+        print_stats(name, &stats, o->verbose, o->json);
+    } else {
+        found = game_solve(g);
+    }
+    if (!found) fprintf(stderr, "Error: %s has no solution\n", name);
+    return found;
+}
+
+static double _now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/** counts the solutions of a game (on 64 bits) */
+static uint64_t _count(cgame g, const char* name, const options* o) {
+    // the frontier counter is tried first: it needs no search, so its statistics only hold the time
+    uint64_t nb;
+    double start = _now();
+    if (game_nb_solutions_frontier(g, &nb)) {
+        if (o->verbose || o->json) {
+            game_stats stats = {.time = _now() - start};
+            print_stats(name, &stats, o->verbose, o->json);
+        }
+    } else if (o->verbose || o->json) {
+        game_stats stats;
+        nb = game_nb_solutions_stats(g, &stats);
+        print_stats(name, &stats, o->verbose, o->json);
+    } else {
+        nb = game_nb_solutions_parallel(g, o->nb_threads);
+    }
+    return nb;
+}
+
+/** writes a rating on one line ("none" if the game has no solution) */
+static bool _print_rating(FILE* out, const char* name, bool found, const game_rating* r) {
+    if (!found) {
+        fprintf(stderr, "Error: %s has no solution\n", name);
+        fprintf(out, "none\n");
+        return false;
+    }
+    fprintf(out, "%s forced %u/%u decisions %" PRIu64 " max_backtrack %u\n", game_difficulty_name(r->tier), r->nb_forced,
+            r->nb_open, r->nb_decisions, r->max_backtrack);
+    return true;
+}
+
+/* ************************************************************************** */
+
+/**
+ * @brief Games read one after the other from an archive or a text stream.
+ * @details A text stream is read in large blocks, and only the lines of the
+ * games not parsed yet are kept in the buffer.
+ */
+typedef struct {
+    const char* name;
+    game_archive archive; // NULL for a text stream
+    FILE* file;
+    char* buf;
+    size_t len;
+    size_t capacity;
+    size_t pos;        // start of the next game in the buffer
+    uint line;         // number of lines before the buffer
+    uint64_t nb_games; // games read so far
+    bool eof;
+} source;
+
+static bool _source_open(source* src, const char* filename) {
+    memset(src, 0, sizeof(source));
+    src->name = filename;
+    if (game_is_archive_filename(filename)) {
+        src->archive = game_archive_open(filename, false);
+        return src->archive != NULL;
+    }
+    src->file = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    src->capacity = STREAM_BLOCK;
+    src->buf = malloc(src->capacity);
+    if (!src->buf) {
+        fprintf(stderr, "Memory allocation error\n");
         exit(EXIT_FAILURE);
     }
+    if (!src->file) fprintf(stderr, "Error: unable to open %s\n", filename);
+    return src->file != NULL;
+}
+
+static void _source_close(source* src) {
+    game_archive_close(src->archive);
+    if (src->file && src->file != stdin) fclose(src->file);
+    free(src->buf);
+}
+
+/** drops the lines already parsed, then reads the next block */
+static void _source_fill(source* src) {
+    size_t keep = src->pos;
+    while (keep > 0 && src->buf[keep - 1] != '\n') keep--;
+    for (size_t k = 0; k < keep; k++) src->line += src->buf[k] == '\n';
+    memmove(src->buf, src->buf + keep, src->len - keep);
+    src->len -= keep;
+    src->pos -= keep;
+    if (src->len == src->capacity) {
+        src->capacity *= 2;
+        char* buf = realloc(src->buf, src->capacity);
+        if (!buf) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        src->buf = buf;
+    }
+    size_t n = fread(src->buf + src->len, 1, src->capacity - src->len, src->file);
+    src->len += n;
+    src->eof = n == 0;
+}
+
+/** next game of the source, NULL at the end (or on a syntax error, reported in *ok) */
+static game _source_next(source* src, bool* ok) {
+    if (src->archive) {
+        game g = game_archive_next(src->archive);
+        if (g) src->nb_games++;
+        else if (game_archive_error(src->archive)) {
+            fprintf(stderr, "Error: %s[%" PRIu64 "] is invalid\n", src->name, src->nb_games);
+            *ok = false;
+        }
+        return g;
+    }
+    while (true) {
+        size_t pos = src->pos;
+        game_parse_error error;
+        game g = game_parse(src->buf, src->len, &pos, &error);
+        if (g) {
+            src->pos = pos;
+            src->nb_games++;
+            return g;
+        }
+        // an error at the end of the buffer only means that more is needed
+        if (error.pos < src->len || src->eof) {
+            size_t k = src->pos;
+            while (k < src->len && (src->buf[k] == ' ' || src->buf[k] == '\t' || src->buf[k] == '\n' || src->buf[k] == '\r')) k++;
+            if (k == src->len && src->eof) return NULL;
+            fprintf(stderr, "Erreur: %s:%u:%u: %s\n", src->name, src->line + error.line, error.col, error.message);
+            *ok = false;
+            return NULL;
+        }
+        _source_fill(src);
+    }
+}
+
+/* ************************************************************************** */
+
+/** @brief A game in flight, and its result. */
+typedef struct {
     game g;
-    if (argc == 3) {
-        if (strcmp(argv[1], "-s") == 0) {
-            char* filename = argv[2];
-            g = game_load(filename);
-            if (!game_solve(g)) {
-                return EXIT_FAILURE;
-            }
-        } else if (strcmp(argv[1], "-c") == 0) {
-            char* filename = argv[2];
-            g = game_load(filename);
-            int a = game_nb_solutions(g);
-            printf("%d\n", a);
+    bool done;
+    bool ok;
+    uint64_t nb_solutions;
+    game_rating rating;
+} batch_slot;
+
+/**
+ * @brief Worker pool of the batch mode.
+ * @details Game k goes in slot k % depth. The reader never gets more than
+ * depth games ahead of the writer, so the memory is bounded, and the writer
+ * (the reader thread too) outputs the results in the input order.
+ */
+typedef struct {
+    const options* o;
+    const char* name;
+    batch_slot* slots;
+    uint depth;
+    uint64_t nb_read;    // games handed to the workers
+    uint64_t nb_taken;   // games taken by a worker
+    uint64_t nb_written; // results written
+    bool eof;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+} batch;
+
+static void _game_name(char* name, size_t size, const char* filename, uint64_t k) {
+    snprintf(name, size, "%s[%" PRIu64 "]", filename, k);
+}
+
+static void* _batch_worker(void* arg) {
+    batch* b = arg;
+    char name[4096];
+    pthread_mutex_lock(&b->lock);
+    while (true) {
+        while (b->nb_taken == b->nb_read && !b->eof) pthread_cond_wait(&b->work, &b->lock);
+        if (b->nb_taken == b->nb_read) break;
+        uint64_t k = b->nb_taken++;
+        batch_slot* slot = &b->slots[k % b->depth];
+        pthread_mutex_unlock(&b->lock);
+
+        _game_name(name, sizeof(name), b->name, k);
+        if (b->o->mode == 's') slot->ok = _solve(slot->g, name, b->o);
+        else if (b->o->mode == 'c') slot->nb_solutions = _count(slot->g, name, b->o);
+        else slot->ok = game_rate(slot->g, &slot->rating);
+
+        pthread_mutex_lock(&b->lock);
+        slot->done = true;
+        pthread_cond_broadcast(&b->done);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+/** waits for the next result in order and writes it (called with the lock held) */
+static bool _batch_write(batch* b, FILE* out, game_archive dst) {
+    uint64_t k = b->nb_written;
+    batch_slot* slot = &b->slots[k % b->depth];
+    while (!slot->done) pthread_cond_wait(&b->done, &b->lock);
+    pthread_mutex_unlock(&b->lock);
+
+    bool ok = true;
+    char name[4096];
+    _game_name(name, sizeof(name), b->name, k);
+    if (b->o->mode == 's') {
+        // an unsolvable game is written as it was read (the solvers leave it
+        // unchanged), so that output game k is always input game k
+        ok = slot->ok;
+        if (dst) ok = game_archive_append(dst, slot->g) && ok;
+        else game_write(slot->g, out);
+    } else if (b->o->mode == 'c') {
+        fprintf(out, "%" PRIu64 "\n", slot->nb_solutions);
+    } else {
+        ok = _print_rating(out, name, slot->ok, &slot->rating);
+    }
+    game_delete(slot->g);
+
+    pthread_mutex_lock(&b->lock);
+    slot->done = false;
+    b->nb_written++;
+    return ok;
+}
+
+/** processes every game of an archive or of a text stream, in order */
+static int _run_batch(char* filename, char* output, const options* o, uint nb_workers) {
+    source src;
+    if (!_source_open(&src, filename)) {
+        _source_close(&src);
+        return EXIT_FAILURE;
+    }
+    game_archive dst = NULL;
+    FILE* out = stdout;
+    if (output && o->mode == 's' && game_is_archive_filename(output)) {
+        dst = game_archive_open(output, true);
+        out = NULL;
+    } else if (output) {
+        out = fopen(output, "w");
+    }
+    if (!dst && !out) {
+        fprintf(stderr, "Error: unable to open %s\n", output);
+        _source_close(&src);
+        return EXIT_FAILURE;
+    }
+
+    batch b = {.o = o, .name = filename, .depth = o->queue_depth};
+    b.slots = calloc(b.depth, sizeof(batch_slot));
+    pthread_t* threads = malloc(nb_workers * sizeof(pthread_t));
+    if (!b.slots || !threads) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.work, NULL);
+    pthread_cond_init(&b.done, NULL);
+    uint nb_threads = 0;
+    for (; nb_threads < nb_workers; nb_threads++)
+        if (pthread_create(&threads[nb_threads], NULL, _batch_worker, &b) != 0) break;
+    if (nb_threads == 0) {
+        fprintf(stderr, "Error: unable to start the workers\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bool ok = true;
+    pthread_mutex_lock(&b.lock);
+    while (true) {
+        while (b.nb_read - b.nb_written >= b.depth) ok = _batch_write(&b, out, dst) && ok;
+        pthread_mutex_unlock(&b.lock);
+        game g = _source_next(&src, &ok);
+        pthread_mutex_lock(&b.lock);
+        if (!g) break;
+        b.slots[b.nb_read % b.depth].g = g;
+        b.nb_read++;
+        pthread_cond_signal(&b.work);
+        while (b.nb_written < b.nb_read && b.slots[b.nb_written % b.depth].done) ok = _batch_write(&b, out, dst) && ok;
+    }
+    b.eof = true;
+    pthread_cond_broadcast(&b.work);
+    while (b.nb_written < b.nb_read) ok = _batch_write(&b, out, dst) && ok;
+    pthread_mutex_unlock(&b.lock);
+    for (uint t = 0; t < nb_threads; t++) pthread_join(threads[t], NULL);
+
+    free(threads);
+    free(b.slots);
+    pthread_cond_destroy(&b.done);
+    pthread_cond_destroy(&b.work);
+    pthread_mutex_destroy(&b.lock);
+    _source_close(&src);
+    if (dst) ok = game_archive_close(dst) && ok;
+    if (out && out != stdout) fclose(out);
+    else if (out) fflush(stdout);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ************************************************************************** */
+
+/** parses a number of the command line, between min and max (no sign, nothing after the digits) */
+static bool _parse_number(const char* text, uint min, uint max, uint* x) {
+    if (text[0] < '0' || text[0] > '9') return false;
+    char* end;
+    errno = 0;
+    unsigned long v = strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || v < min || v > max) return false;
+    *x = v;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage(argc, argv);
+    }
+    char* option = argv[1];
+    char* filename = NULL;
+    char* output = NULL;
+    options o = {.nb_threads = 1, .queue_depth = DEFAULT_QUEUE_DEPTH};
+    for (int k = 2; k < argc; k++) {
+        if (strcmp(argv[k], "-j") == 0) {
+            if (k + 1 >= argc) usage(argc, argv);
+            if (!_parse_number(argv[++k], 0, MAX_THREADS, &o.nb_threads)) usage(argc, argv);
+        } else if (strcmp(argv[k], "--batch") == 0) {
+            o.batch = true;
+        } else if (strcmp(argv[k], "--queue") == 0) {
+            if (k + 1 >= argc) usage(argc, argv);
+            if (!_parse_number(argv[++k], 1, UINT_MAX, &o.queue_depth)) usage(argc, argv);
+        } else if (strcmp(argv[k], "--sat") == 0) {
+            o.sat = true;
+        } else if (strcmp(argv[k], "-v") == 0) {
+            o.verbose = true;
+        } else if (strcmp(argv[k], "--json") == 0) {
+            if (k + 1 >= argc) usage(argc, argv);
+            o.json = argv[++k];
+        } else if (!filename) {
+            filename = argv[k];
+        } else if (!output) {
+            output = argv[k];
         } else {
             usage(argc, argv);
         }
     }
+    if (!filename) {
+        usage(argc, argv);
+    }
+    if (strcmp(option, "-s") != 0 && strcmp(option, "-c") != 0 && strcmp(option, "-r") != 0) {
+        usage(argc, argv);
+    }
+    o.mode = option[1];
+    if (o.batch) {
+        // the workers share the processors: each game is counted on one thread
+        uint nb_workers = o.nb_threads > 0 ? o.nb_threads : sysconf(_SC_NPROCESSORS_ONLN);
+        o.nb_threads = 1;
+        return _run_batch(filename, output, &o, nb_workers > 0 ? nb_workers : 1);
+    }
+    if (game_is_archive_filename(filename)) {
+        return _run_batch(filename, output, &o, 1);
+    }
 
-    else if (argc == 4) {
-        if (strcmp(argv[1], "-s") == 0) {
-            char* filename = argv[2];
-            char* output = argv[3];
-            g = game_load(filename);
-            if (!game_solve(g)) {
-                return EXIT_FAILURE;
-            } else {
+    game g = game_load(filename);
+    if (!g) {
+        return EXIT_FAILURE;
+    }
+    bool ok = true;
+    if (o.mode == 's') {
+        ok = _solve(g, filename, &o);
+        if (ok) {
+            game_print(g);
+            if (output && game_is_archive_filename(output)) {
+                game_archive a = game_archive_open(output, true);
+                ok = a && game_archive_append(a, g);
+                ok = game_archive_close(a) && ok;
+            } else if (output) {
                 game_save(g, output);
             }
-        } else if (strcmp(argv[1], "-c") == 0) {
-            char* filename = argv[2];
-            char* output = argv[3];
-            FILE* f = fopen(output, "w");
-            g = game_load(filename);
-            int a = game_nb_solutions(g);
-            fprintf(f, "%d\n", a);
+        }
+    } else {
+        FILE* f = output ? fopen(output, "w") : stdout;
+        if (!f) {
+            fprintf(stderr, "Error: unable to open %s\n", output);
+            game_delete(g);
+            return EXIT_FAILURE;
+        }
+        if (o.mode == 'c') {
+            fprintf(f, "%" PRIu64 "\n", _count(g, filename, &o));
         } else {
-            usage(argc, argv);
+            game_rating r;
+            ok = _print_rating(f, filename, game_rate(g, &r), &r);
         }
+        if (output) fclose(f);
     }
-    return EXIT_SUCCESS;
+    game_delete(g);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
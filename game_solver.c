@@ -0,0 +1,518 @@
+#include "game_solver.h"
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_struct.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+#define OPPOSITE_DIR(d) ((d + 2) % NB_DIRS)
+#define DIR_MASK(d) (0b1000 >> (d))
+#define NO_SQUARE ((uint)-1)
+#define STOP_POLL_MASK 255 // the stop function is polled every 256 nodes
+
+/* ************************************************************************** */
+
+/** @brief Saved domain, restored when the search backtracks. */
+typedef struct {
+    uint square;
+    uint8_t domain;
+} trail_entry;
+
+/** @brief Branching point of the search. */
+typedef struct {
+    uint square;  // branching square
+    uint8_t todo; // orientations not tried yet
+    uint mark;    // trail length before branching
+} frame;
+
+struct solver_s {
+    uint nb_rows;
+    uint nb_cols;
+    uint size;
+    uint nb_pieces;   // number of non-empty squares
+    uint first_piece; // first non-empty square (row-major)
+
+    uint8_t* shapes;   // shape of each square
+    uint8_t* domains;  // bitmask of the orientations still allowed
+    uint8_t* solution; // orientation of each square in the last solution
+    uint* neighbors;   // NB_DIRS adjacent squares per square (or NO_SQUARE)
+
+    // propagation worklist (circular, each square at most once)
+    uint* queue;
+    uint8_t* queued;
+    uint queue_head;
+    uint queue_len;
+
+    // undo information
+    trail_entry* trail;
+    uint trail_len;
+    frame* frames;
+
+    // connectivity check
+    uint* stack;
+    uint8_t* visited;
+
+    // union (any) and intersection (all) of the codes allowed by a domain
+    uint8_t any[NB_SHAPES][16];
+    uint8_t all[NB_SHAPES][16];
+
+    game_stats* stats; // optional search statistics
+
+    // optional interruption of the search
+    bool (*stop)(void* data);
+    void* stop_data;
+    uint64_t nb_polls;
+    bool stopped;
+};
+
+static const uint8_t _popcount[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+/* ************************************************************************** */
+
+/** domain of a shape: one orientation per distinct half-edge code */
+static uint8_t _initial_domain(shape s) {
+    uint8_t dom = 0;
+    for (uint o = 0; o < NB_DIRS; o++) {
+        bool dup = false;
+        for (uint p = 0; p < o; p++)
+            if (_code[s][p] == _code[s][o]) dup = true;
+        if (!dup) dom |= 1 << o;
+    }
+    return dom;
+}
+
+/* ************************************************************************** */
+
+/** lowest orientation of a domain */
+static direction _first_dir(uint8_t dom) {
+    assert(dom != 0);
+    direction o = NORTH;
+    while (!(dom & (1 << o))) o++;
+    return o;
+}
+
+/* ************************************************************************** */
+
+solver* solver_new(cgame g) {
+    assert(g);
+    solver* s = calloc(1, sizeof(solver));
+    if (!s) return NULL;
+
+    s->nb_rows = game_nb_rows(g);
+    s->nb_cols = game_nb_cols(g);
+    s->size = s->nb_rows * s->nb_cols;
+    s->first_piece = NO_SQUARE;
+
+    uint size = s->size;
+    s->shapes = malloc(size * sizeof(uint8_t));
+    s->domains = malloc(size * sizeof(uint8_t));
+    s->solution = malloc(size * sizeof(uint8_t));
+    s->neighbors = malloc(size * NB_DIRS * sizeof(uint));
+    s->queue = malloc(size * sizeof(uint));
+    s->queued = calloc(size, sizeof(uint8_t));
+    s->trail = malloc(size * NB_DIRS * sizeof(trail_entry));
+    s->frames = malloc(size * sizeof(frame));
+    s->stack = malloc(size * sizeof(uint));
+    s->visited = malloc(size * sizeof(uint8_t));
+    if (!s->shapes || !s->domains || !s->solution || !s->neighbors || !s->queue || !s->queued || !s->trail || !s->frames ||
+        !s->stack || !s->visited) {
+        solver_delete(s);
+        return NULL;
+    }
+
+    for (uint i = 0; i < s->nb_rows; i++) {
+        for (uint j = 0; j < s->nb_cols; j++) {
+            uint sq = i * s->nb_cols + j;
+            shape sh = _game_shape(g, sq);
+            s->shapes[sq] = sh;
+            s->domains[sq] = _initial_domain(sh);
+            if (sh != EMPTY) {
+                if (s->nb_pieces == 0) s->first_piece = sq;
+                s->nb_pieces++;
+            }
+            for (direction d = NORTH; d < NB_DIRS; d++) {
+                uint ni, nj;
+                bool next = game_get_ajacent_square(g, i, j, d, &ni, &nj);
+                s->neighbors[sq * NB_DIRS + d] = next ? ni * s->nb_cols + nj : NO_SQUARE;
+            }
+        }
+    }
+
+    for (shape sh = EMPTY; sh < NB_SHAPES; sh++) {
+        for (uint dom = 1; dom < 16; dom++) {
+            uint8_t any = 0, all = 0b1111;
+            for (uint o = 0; o < NB_DIRS; o++) {
+                if (dom & (1 << o)) {
+                    any |= _code[sh][o];
+                    all &= _code[sh][o];
+                }
+            }
+            s->any[sh][dom] = any;
+            s->all[sh][dom] = all;
+        }
+    }
+    return s;
+}
+
+/* ************************************************************************** */
+
+void solver_delete(solver* s) {
+    if (!s) return;
+    free(s->shapes);
+    free(s->domains);
+    free(s->solution);
+    free(s->neighbors);
+    free(s->queue);
+    free(s->queued);
+    free(s->trail);
+    free(s->frames);
+    free(s->stack);
+    free(s->visited);
+    free(s);
+}
+
+/* ************************************************************************** */
+
+static void _enqueue(solver* s, uint sq) {
+    if (s->queued[sq]) return;
+    s->queued[sq] = 1;
+    s->queue[(s->queue_head + s->queue_len) % s->size] = sq;
+    s->queue_len++;
+}
+
+static void _enqueue_neighbors(solver* s, uint sq) {
+    for (direction d = NORTH; d < NB_DIRS; d++) {
+        uint n = s->neighbors[sq * NB_DIRS + d];
+        if (n != NO_SQUARE && n != sq) _enqueue(s, n);
+    }
+}
+
+static void _clear_queue(solver* s) {
+    while (s->queue_len > 0) {
+        s->queued[s->queue[s->queue_head]] = 0;
+        s->queue_head = (s->queue_head + 1) % s->size;
+        s->queue_len--;
+    }
+}
+
+/* ************************************************************************** */
+
+static void _set_domain(solver* s, uint sq, uint8_t dom) {
+    assert(s->trail_len < s->size * NB_DIRS);
+    s->trail[s->trail_len++] = (trail_entry){sq, s->domains[sq]};
+    s->domains[sq] = dom;
+}
+
+static void _undo(solver* s, uint mark) {
+    while (s->trail_len > mark) {
+        trail_entry e = s->trail[--s->trail_len];
+        s->domains[e.square] = e.domain;
+    }
+}
+
+/* ************************************************************************** */
+
+/**
+ * @brief Removes from the domain of a square the orientations that disagree
+ * with the neighbours.
+ * @param s the solver
+ * @param sq the square
+ * @param border if false, the border of the grid and the half-edges looping
+ * back onto the square are ignored (only used to find why a domain is empty)
+ * @return the filtered domain (0 if nothing is left)
+ */
+static uint8_t _filter(const solver* s, uint sq, bool border) {
+    uint8_t must = 0; // half-edges required by the neighbours
+    uint8_t may = 0;  // half-edges allowed by the neighbours
+    uint8_t self = 0; // half-edges looping back onto the square itself
+    for (direction d = NORTH; d < NB_DIRS; d++) {
+        uint n = s->neighbors[sq * NB_DIRS + d];
+        if (!border && (n == NO_SQUARE || n == sq)) {
+            may |= DIR_MASK(d);
+            continue;
+        }
+        if (n == NO_SQUARE) continue;
+        if (n == sq) {
+            self |= DIR_MASK(d);
+            may |= DIR_MASK(d);
+            continue;
+        }
+        uint8_t opp = DIR_MASK(OPPOSITE_DIR(d));
+        if (s->any[s->shapes[n]][s->domains[n]] & opp) may |= DIR_MASK(d);
+        if (s->all[s->shapes[n]][s->domains[n]] & opp) must |= DIR_MASK(d);
+    }
+
+    uint8_t dom = s->domains[sq];
+    uint8_t keep = 0;
+    for (uint o = 0; o < NB_DIRS; o++) {
+        if (!(dom & (1 << o))) continue;
+        uint8_t code = _code[s->shapes[sq]][o];
+        if ((code & must) != must || (code & ~may)) continue;
+        bool ok = true;
+        for (direction d = NORTH; d < NB_DIRS && ok; d++) {
+            if (self & DIR_MASK(d)) ok = !(code & DIR_MASK(d)) == !(code & DIR_MASK(OPPOSITE_DIR(d)));
+        }
+        if (ok) keep |= 1 << o;
+    }
+    return keep;
+}
+
+/* ************************************************************************** */
+
+/** propagates edge agreement until nothing changes */
+static bool _propagate(solver* s) {
+    while (s->queue_len > 0) {
+        uint sq = s->queue[s->queue_head];
+        s->queue_head = (s->queue_head + 1) % s->size;
+        s->queue_len--;
+        s->queued[sq] = 0;
+
+        uint8_t dom = _filter(s, sq, true);
+        if (dom == 0) {
+            if (s->stats) s->stats->nb_prunes[_filter(s, sq, false) ? PRUNE_BORDER : PRUNE_EDGE]++;
+            _clear_queue(s);
+            return false;
+        }
+        if (dom != s->domains[sq]) {
+            _set_domain(s, sq, dom);
+            _enqueue_neighbors(s, sq);
+        }
+    }
+    return true;
+}
+
+/* ************************************************************************** */
+
+/**
+ * @brief Checks that all the pieces can still be part of the same network,
+ * using every edge that both sides may still have.
+ */
+static bool _is_connectable(solver* s) {
+    if (s->nb_pieces == 0) return true;
+    memset(s->visited, 0, s->size * sizeof(uint8_t));
+    uint top = 0, count = 1;
+    s->stack[top++] = s->first_piece;
+    s->visited[s->first_piece] = 1;
+    while (top > 0) {
+        uint sq = s->stack[--top];
+        uint8_t may = s->any[s->shapes[sq]][s->domains[sq]];
+        for (direction d = NORTH; d < NB_DIRS; d++) {
+            if (!(may & DIR_MASK(d))) continue;
+            uint n = s->neighbors[sq * NB_DIRS + d];
+            if (n == NO_SQUARE || s->visited[n]) continue;
+            if (s->any[s->shapes[n]][s->domains[n]] & DIR_MASK(OPPOSITE_DIR(d))) {
+                s->visited[n] = 1;
+                s->stack[top++] = n;
+                count++;
+            }
+        }
+    }
+    return count == s->nb_pieces;
+}
+
+/** propagates, then checks the connectivity (and records why a node fails) */
+static bool _consistent(solver* s) {
+    if (!_propagate(s)) return false;
+    if (_is_connectable(s)) return true;
+    if (s->stats) s->stats->nb_prunes[PRUNE_CONNECTIVITY]++;
+    return false;
+}
+
+/** records a node of the search at a given depth */
+static void _record_node(solver* s, uint depth, bool ok) {
+    game_stats* st = s->stats;
+    st->nb_nodes++;
+    if (depth > st->max_depth) st->max_depth = depth;
+    if (!ok) st->nb_backtracks[depth < GAME_STATS_MAX_DEPTH ? depth : GAME_STATS_MAX_DEPTH - 1]++;
+}
+
+/* ************************************************************************** */
+
+/** picks the undecided square with the smallest domain (or NO_SQUARE) */
+static uint _choose(const solver* s) {
+    uint best = NO_SQUARE;
+    uint best_size = NB_DIRS + 1;
+    for (uint sq = 0; sq < s->size; sq++) {
+        uint n = _popcount[s->domains[sq]];
+        if (n > 1 && n < best_size) {
+            best = sq;
+            best_size = n;
+            if (n == 2) break;
+        }
+    }
+    return best;
+}
+
+/** @brief Subtrees collected by solver_split. */
+typedef struct {
+    uint8_t* domains;
+    uint nb;
+    uint capacity;
+} subtree_list;
+
+static bool _push_subtree(subtree_list* l, const solver* s) {
+    if (l->nb == l->capacity) {
+        uint capacity = l->capacity ? 2 * l->capacity : 16;
+        uint8_t* domains = realloc(l->domains, (size_t)capacity * s->size);
+        if (!domains) return false;
+        l->domains = domains;
+        l->capacity = capacity;
+    }
+    memcpy(l->domains + (size_t)l->nb * s->size, s->domains, s->size);
+    l->nb++;
+    return true;
+}
+
+/* ************************************************************************** */
+
+/**
+ * @brief Depth-first search with propagation at each node.
+ * @param s the solver
+ * @param limit stops as soon as this number of solutions is found
+ * @param split if not NULL, the nodes reached after @p depth branching levels
+ * are saved in this list instead of being explored
+ * @param depth number of branching levels explored before splitting
+ * @return the number of solutions found
+ */
+static uint64_t _search(solver* s, uint64_t limit, subtree_list* split, uint depth) {
+    uint64_t nb = 0;
+    uint nb_frames = 0;
+    s->stopped = false;
+
+    for (uint sq = 0; sq < s->size; sq++) _enqueue(s, sq);
+    bool ok = _consistent(s);
+    if (s->stats) _record_node(s, 0, ok);
+
+    while (true) {
+        if (s->stop && (s->nb_polls++ & STOP_POLL_MASK) == 0 && s->stop(s->stop_data)) {
+            s->stopped = true;
+            break;
+        }
+        if (ok) {
+            uint sq = _choose(s);
+            if (sq == NO_SQUARE) {
+                // every square is decided and consistent: this is a solution
+                for (uint k = 0; k < s->size; k++) s->solution[k] = _first_dir(s->domains[k]);
+                nb++;
+                if (nb >= limit) break;
+            } else if (split && nb_frames == depth) {
+                if (!_push_subtree(split, s)) {
+                    fprintf(stderr, "Memory allocation error\n");
+                    exit(EXIT_FAILURE);
+                }
+            } else {
+                s->frames[nb_frames++] = (frame){sq, s->domains[sq], s->trail_len};
+            }
+        }
+
+        // backtrack to the deepest branching point with an untried orientation
+        while (nb_frames > 0 && s->frames[nb_frames - 1].todo == 0) {
+            nb_frames--;
+            _undo(s, s->frames[nb_frames].mark);
+        }
+        if (nb_frames == 0) break;
+
+        frame* f = &s->frames[nb_frames - 1];
+        _undo(s, f->mark);
+        uint8_t bit = f->todo & -f->todo;
+        f->todo &= ~bit;
+        _set_domain(s, f->square, bit);
+        _enqueue_neighbors(s, f->square);
+        ok = _consistent(s);
+        if (s->stats) _record_node(s, nb_frames, ok);
+    }
+
+    _undo(s, 0);
+    return nb;
+}
+
+/* ************************************************************************** */
+
+bool solver_solve(solver* s) {
+    assert(s);
+    return _search(s, 1, NULL, 0) > 0;
+}
+
+uint64_t solver_count(solver* s) {
+    assert(s);
+    return _search(s, UINT64_MAX, NULL, 0);
+}
+
+uint64_t solver_count_limit(solver* s, uint64_t limit) {
+    assert(s && limit > 0);
+    return _search(s, limit, NULL, 0);
+}
+
+bool solver_deduce(solver* s, uint* nb_open, uint* nb_forced) {
+    assert(s && nb_open && nb_forced);
+    for (uint sq = 0; sq < s->size; sq++) _enqueue(s, sq);
+    bool ok = _consistent(s);
+    *nb_open = *nb_forced = 0;
+    for (uint sq = 0; sq < s->size; sq++) {
+        if (_popcount[_initial_domain(s->shapes[sq])] < 2) continue;
+        (*nb_open)++;
+        if (_popcount[s->domains[sq]] == 1) (*nb_forced)++;
+    }
+    _undo(s, 0);
+    return ok;
+}
+
+/* ************************************************************************** */
+
+uint8_t* solver_split(solver* s, uint depth, uint* nb_subtrees, uint64_t* nb_solutions) {
+    assert(s && nb_subtrees && nb_solutions);
+    subtree_list l = {NULL, 0, 0};
+    *nb_solutions = _search(s, UINT64_MAX, &l, depth);
+    *nb_subtrees = l.nb;
+    return l.domains;
+}
+
+void solver_set_domains(solver* s, const uint8_t* domains) {
+    assert(s && domains);
+    memcpy(s->domains, domains, s->size);
+}
+
+void solver_set_stats(solver* s, game_stats* stats) {
+    assert(s);
+    s->stats = stats;
+}
+
+void solver_set_stop(solver* s, bool (*stop)(void* data), void* data) {
+    assert(s);
+    s->stop = stop;
+    s->stop_data = data;
+    s->nb_polls = 0;
+}
+
+bool solver_stopped(const solver* s) {
+    assert(s);
+    return s->stopped;
+}
+
+/* ************************************************************************** */
+
+void solver_get_solution(const solver* s, uint8_t* orientations) {
+    assert(s && orientations);
+    memcpy(orientations, s->solution, s->size);
+}
+
+void solver_apply(const solver* s, game g) {
+    assert(s && g);
+    for (uint i = 0; i < s->nb_rows; i++) {
+        for (uint j = 0; j < s->nb_cols; j++) {
+            uint sq = i * s->nb_cols + j;
+            shape sh = s->shapes[sq];
+            direction o = s->solution[sq];
+            if (_code[sh][_game_orientation(g, sq)] != _code[sh][o]) {
+                game_set_piece_orientation(g, i, j, o);
+            }
+        }
+    }
+}
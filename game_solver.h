@@ -0,0 +1,149 @@
+/**
+ * @file game_solver.h
+ * @brief Solver Engine.
+ * @details Constraint-propagation engine behind @ref game_solve and
+ * @ref game_nb_solutions. Each square keeps a domain of the orientations that
+ * are still allowed (only one orientation per distinct half-edge code, so that
+ * symmetrical positions of SEGMENT, CROSS and EMPTY are not counted twice).
+ * Edge agreement with the neighbours is propagated until nothing changes, and
+ * the search only branches when the propagation stalls.
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#ifndef __GAME_SOLVER_H__
+#define __GAME_SOLVER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "game_tools.h"
+
+/**
+ * @brief Opaque structure storing the state of the solver engine.
+ **/
+typedef struct solver_s solver;
+
+/**
+ * @brief Creates a solver engine for a given game.
+ * @details The engine works on its own copy of the grid, the game @p g is
+ * never modified.
+ * @param g the game to solve
+ * @pre @p g must be a valid pointer toward a game structure.
+ * @return the created solver (or NULL in case of error)
+ **/
+solver* solver_new(cgame g);
+
+/**
+ * @brief Deletes the solver engine and frees the allocated memory.
+ * @param s the solver
+ **/
+void solver_delete(solver* s);
+
+/**
+ * @brief Searches the first solution.
+ * @param s the solver
+ * @return true if a solution is found, false otherwise
+ **/
+bool solver_solve(solver* s);
+
+/**
+ * @brief Counts all the solutions.
+ * @param s the solver
+ * @return the number of solutions
+ **/
+uint64_t solver_count(solver* s);
+
+/**
+ * @brief Counts the solutions, stopping as soon as a given number is reached.
+ * @details With a limit of 2, this tells whether the solution is unique
+ * without paying for a full count.
+ * @param s the solver
+ * @param limit maximum number of solutions to look for (at least 1)
+ * @return the number of solutions, up to @p limit
+ **/
+uint64_t solver_count_limit(solver* s, uint64_t limit);
+
+/**
+ * @brief Propagates the constraints once, without any branching.
+ * @details Counts the pieces that local deduction alone can orient. The
+ * domains are restored afterwards, so a search can follow.
+ * @param s the solver
+ * @param nb_open number of pieces with several distinct orientations (output)
+ * @param nb_forced number of these pieces whose orientation is deduced (output)
+ * @return false if the deduction already shows that there is no solution
+ **/
+bool solver_deduce(solver* s, uint* nb_open, uint* nb_forced);
+
+/**
+ * @brief Splits the search tree into independent subtrees.
+ * @details The first @p depth branching levels are explored. Each node reached
+ * at that depth is returned as a snapshot of the domains of all the squares,
+ * which can be counted on its own with @ref solver_set_domains and
+ * @ref solver_count.
+ * @param s the solver
+ * @param depth number of branching levels to explore
+ * @param[out] nb_subtrees number of subtrees (output)
+ * @param[out] nb_solutions number of solutions found above @p depth (output)
+ * @return an array of @p nb_subtrees snapshots of nb_rows*nb_cols domains
+ * (to be freed by the caller), or NULL if there is no subtree
+ **/
+uint8_t* solver_split(solver* s, uint depth, uint* nb_subtrees, uint64_t* nb_solutions);
+
+/**
+ * @brief Restarts the solver from a snapshot returned by @ref solver_split.
+ * @param s the solver
+ * @param domains the domains of all the squares
+ **/
+void solver_set_domains(solver* s, const uint8_t* domains);
+
+/**
+ * @brief Records search statistics in a given structure.
+ * @details The counters of @p stats are incremented by each following search
+ * (the wall-clock time is left to the caller).
+ * @param s the solver
+ * @param stats the statistics to fill in (or NULL to stop recording)
+ **/
+void solver_set_stats(solver* s, game_stats* stats);
+
+/**
+ * @brief Lets a search be interrupted.
+ * @details The function @p stop is polled regularly during the search (at the
+ * first node, then every few hundred nodes). As soon as it returns true, the
+ * search gives up and @ref solver_stopped returns true.
+ * @param s the solver
+ * @param stop the polled function (or NULL to never stop)
+ * @param data the argument given to @p stop
+ **/
+void solver_set_stop(solver* s, bool (*stop)(void* data), void* data);
+
+/**
+ * @brief Tells if the last search has been interrupted.
+ * @param s the solver
+ * @return true if the last search gave up because of @ref solver_set_stop
+ **/
+bool solver_stopped(const solver* s);
+
+/**
+ * @brief Gets the orientations of the last solution found.
+ * @details Solutions are found in a deterministic order, so after
+ * @ref solver_count_limit with a limit of 2, this is the second solution,
+ * while @ref solver_solve gives the first one.
+ * @param s the solver
+ * @param orientations the orientation of each square in row-major order
+ * (output, nb_rows*nb_cols values)
+ * @pre a solution must have been found.
+ **/
+void solver_get_solution(const solver* s, uint8_t* orientations);
+
+/**
+ * @brief Copies the last solution found into a game.
+ * @details Squares whose current orientation is equivalent to the solution
+ * (same half-edges) are left untouched.
+ * @param s the solver
+ * @param g the game used to create the solver
+ * @pre @ref solver_solve must have returned true.
+ **/
+void solver_apply(const solver* s, game g);
+
+#endif // __GAME_SOLVER_H__
@@ -0,0 +1,238 @@
+#include "game.h"
+#include "game_ext.h"
+#include "game_struct.h"
+#include "game_tools.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+/**
+ * @brief Frontier (broken-profile) dynamic programming solution counter.
+ * @details The grid is swept square by square in row-major order, along its
+ * smallest dimension. A state only keeps the frontier between the squares
+ * already placed and the others: W vertical slots (the south half-edge of the
+ * last square of each column) plus one horizontal slot (the east half-edge of
+ * the previous square). Each slot holds 0 when there is no dangling half-edge,
+ * or the label of the network it belongs to, so that merges and closed
+ * networks can be detected. Identical frontiers are merged and their number of
+ * partial solutions are added up.
+ */
+
+#define MAX_WIDTH 14                      // W + 1 slots of 4 bits, labels up to 15
+#define SLOT_BITS 4
+#define CLOSED_KEY ((uint64_t)1 << 63)    // the single network is closed
+#define FREE_KEY (~(uint64_t)0)           // free entry of the hash table
+#define NEW_LABEL 15
+
+#define N_BIT 0b1000
+#define E_BIT 0b0100
+#define S_BIT 0b0010
+#define W_BIT 0b0001
+
+/* ************************************************************************** */
+
+/** @brief Hash table from frontier states to their number of partial solutions. */
+typedef struct {
+    uint64_t* keys;
+    uint64_t* counts;
+    size_t capacity; // power of 2
+    size_t nb;
+} state_table;
+
+static bool _table_init(state_table* t, size_t capacity) {
+    t->keys = malloc(capacity * sizeof(uint64_t));
+    t->counts = malloc(capacity * sizeof(uint64_t));
+    t->capacity = capacity;
+    t->nb = 0;
+    if (!t->keys || !t->counts) return false;
+    memset(t->keys, 0xff, capacity * sizeof(uint64_t));
+    return true;
+}
+
+static void _table_free(state_table* t) {
+    free(t->keys);
+    free(t->counts);
+}
+
+static void _table_clear(state_table* t) {
+    memset(t->keys, 0xff, t->capacity * sizeof(uint64_t));
+    t->nb = 0;
+}
+
+static size_t _hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static bool _table_add(state_table* t, uint64_t key, uint64_t count, bool* overflow);
+
+static bool _table_grow(state_table* t, bool* overflow) {
+    state_table bigger;
+    if (!_table_init(&bigger, 2 * t->capacity)) return false;
+    for (size_t k = 0; k < t->capacity; k++) {
+        if (t->keys[k] != FREE_KEY) _table_add(&bigger, t->keys[k], t->counts[k], overflow);
+    }
+    _table_free(t);
+    *t = bigger;
+    return true;
+}
+
+/** adds count to the state key (saturating, with an overflow flag) */
+static bool _table_add(state_table* t, uint64_t key, uint64_t count, bool* overflow) {
+    if (2 * (t->nb + 1) > t->capacity && !_table_grow(t, overflow)) return false;
+    size_t mask = t->capacity - 1;
+    size_t k = _hash(key) & mask;
+    while (t->keys[k] != FREE_KEY && t->keys[k] != key) k = (k + 1) & mask;
+    if (t->keys[k] == FREE_KEY) {
+        t->keys[k] = key;
+        t->counts[k] = count;
+        t->nb++;
+    } else {
+        uint64_t sum = t->counts[k] + count;
+        if (sum < count) {
+            *overflow = true;
+            sum = ~(uint64_t)0;
+        }
+        t->counts[k] = sum;
+    }
+    return true;
+}
+
+/* ************************************************************************** */
+
+static uint _get_slot(uint64_t key, uint s) { return (key >> (SLOT_BITS * s)) & 0xf; }
+
+/** relabels the networks of the frontier in order of first appearance */
+static uint64_t _normalize(const uint8_t* slots, uint nb_slots) {
+    uint8_t relabel[16] = {0};
+    uint next = 1;
+    uint64_t key = 0;
+    for (uint s = 0; s < nb_slots; s++) {
+        uint8_t l = slots[s];
+        if (l && !relabel[l]) relabel[l] = next++;
+        key |= (uint64_t)relabel[l] << (SLOT_BITS * s);
+    }
+    return key;
+}
+
+/** transposes a half-edge code (north <-> west, east <-> south) */
+static uint _transpose_code(uint code) {
+    return ((code & W_BIT) ? N_BIT : 0) | ((code & N_BIT) ? W_BIT : 0) | ((code & S_BIT) ? E_BIT : 0) | ((code & E_BIT) ? S_BIT : 0);
+}
+
+/* ************************************************************************** */
+
+/**
+ * @brief Applies all the codes of a square to one frontier state.
+ * @return false on memory allocation error
+ */
+static bool _expand(state_table* next, uint64_t key, uint64_t count, const uint8_t* codes, uint nb_codes, uint c, uint width,
+                    bool last_row, bool* overflow) {
+    uint8_t slots[MAX_WIDTH + 1];
+    for (uint k = 0; k < nb_codes; k++) {
+        uint code = codes[k];
+        if (key == CLOSED_KEY) {
+            // once the network is closed, only empty squares may follow
+            if (code == 0 && !_table_add(next, key, count, overflow)) return false;
+            continue;
+        }
+        uint up = _get_slot(key, c);
+        uint left = _get_slot(key, width);
+        if (!(code & N_BIT) != !up || !(code & W_BIT) != !left) continue;
+        if ((c == width - 1 && (code & E_BIT)) || (last_row && (code & S_BIT))) continue;
+        if (code == 0) {
+            if (!_table_add(next, key, count, overflow)) return false;
+            continue;
+        }
+
+        for (uint s = 0; s <= width; s++) slots[s] = _get_slot(key, s);
+        uint label = up ? up : (left ? left : NEW_LABEL);
+        if (up && left && up != left) {
+            for (uint s = 0; s <= width; s++)
+                if (slots[s] == left) slots[s] = up;
+        }
+        slots[c] = (code & S_BIT) ? label : 0;
+        slots[width] = (code & E_BIT) ? label : 0;
+
+        bool open = false, others = false;
+        for (uint s = 0; s <= width; s++) {
+            if (slots[s] == label) open = true;
+            else if (slots[s]) others = true;
+        }
+        uint64_t new_key;
+        if (open) {
+            new_key = _normalize(slots, width + 1);
+        } else if (others) {
+            continue; // this network is closed while others remain: disconnected
+        } else {
+            new_key = CLOSED_KEY;
+        }
+        if (!_table_add(next, new_key, count, overflow)) return false;
+    }
+    return true;
+}
+
+/* ************************************************************************** */
+
+bool game_nb_solutions_frontier(cgame g, uint64_t* nb_solutions) {
+    assert(g && nb_solutions);
+    if (game_is_wrapping(g)) return false;
+    uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+    bool transposed = nb_cols > nb_rows;
+    uint width = transposed ? nb_rows : nb_cols;
+    uint height = transposed ? nb_cols : nb_rows;
+    if (width > MAX_WIDTH) return false;
+
+    state_table cur, next;
+    if (!_table_init(&cur, 1024) || !_table_init(&next, 1024)) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    bool overflow = false;
+    _table_add(&cur, 0, 1, &overflow);
+
+    for (uint r = 0; r < height; r++) {
+        for (uint c = 0; c < width; c++) {
+            // distinct codes of the square (symmetrical positions counted once)
+            shape s = transposed ? _game_shape(g, c * nb_cols + r) : _game_shape(g, r * nb_cols + c);
+            uint8_t codes[NB_DIRS];
+            uint nb_codes = 0;
+            for (direction o = NORTH; o < NB_DIRS; o++) {
+                uint code = transposed ? _transpose_code(_code[s][o]) : _code[s][o];
+                bool dup = false;
+                for (uint k = 0; k < nb_codes; k++) dup = dup || codes[k] == code;
+                if (!dup) codes[nb_codes++] = code;
+            }
+
+            _table_clear(&next);
+            for (size_t k = 0; k < cur.capacity; k++) {
+                if (cur.keys[k] == FREE_KEY) continue;
+                if (!_expand(&next, cur.keys[k], cur.counts[k], codes, nb_codes, c, width, r == height - 1, &overflow)) {
+                    fprintf(stderr, "Memory allocation error\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            state_table tmp = cur;
+            cur = next;
+            next = tmp;
+        }
+    }
+
+    // valid end states: one closed network, or no piece at all
+    uint64_t nb = 0;
+    for (size_t k = 0; k < cur.capacity; k++) {
+        if (cur.keys[k] == CLOSED_KEY || cur.keys[k] == 0) nb += cur.counts[k];
+    }
+    _table_free(&cur);
+    _table_free(&next);
+    if (overflow) return false;
+    *nb_solutions = nb;
+    return true;
+}
@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_solver.h"
+#include "game_tools.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+#define SUBTREES_PER_THREAD 16
+#define MAX_SPLIT_DEPTH 64
+
+/* ************************************************************************** */
+
+/**
+ * @brief Double-ended queue of subtrees owned by a worker.
+ * @details The owner pops its own subtrees from the tail, idle workers steal
+ * from the head.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    uint* tasks;
+    uint head;
+    uint tail;
+} task_deque;
+
+typedef struct worker_s worker;
+
+/** @brief Data shared by all the workers. */
+typedef struct {
+    cgame g;
+    const uint8_t* subtrees; // nb_subtrees snapshots of size domains
+    uint size;
+    uint nb_workers;
+    worker* workers;
+} pool;
+
+struct worker_s {
+    pool* p;
+    uint id;
+    task_deque deque;
+    uint64_t nb_solutions;
+    bool failed;
+};
+
+/* ************************************************************************** */
+
+static bool _pop_own(worker* w, uint* task) {
+    bool ok = false;
+    pthread_mutex_lock(&w->deque.lock);
+    if (w->deque.head < w->deque.tail) {
+        *task = w->deque.tasks[--w->deque.tail];
+        ok = true;
+    }
+    pthread_mutex_unlock(&w->deque.lock);
+    return ok;
+}
+
+static bool _steal(worker* w, uint* task) {
+    pool* p = w->p;
+    for (uint k = 1; k < p->nb_workers; k++) {
+        worker* victim = &p->workers[(w->id + k) % p->nb_workers];
+        pthread_mutex_lock(&victim->deque.lock);
+        bool ok = victim->deque.head < victim->deque.tail;
+        if (ok) *task = victim->deque.tasks[victim->deque.head++];
+        pthread_mutex_unlock(&victim->deque.lock);
+        if (ok) return true;
+    }
+    return false;
+}
+
+/* ************************************************************************** */
+
+static void* _worker_run(void* arg) {
+    worker* w = arg;
+    pool* p = w->p;
+    // each worker counts on its own private copy of the grid
+    solver* s = solver_new(p->g);
+    if (!s) {
+        w->failed = true;
+        return NULL;
+    }
+    uint task;
+    // no subtree is created after the start, so empty deques mean we are done
+    while (_pop_own(w, &task) || _steal(w, &task)) {
+        solver_set_domains(s, p->subtrees + (size_t)task * p->size);
+        w->nb_solutions += solver_count(s);
+    }
+    solver_delete(s);
+    return NULL;
+}
+
+/* ************************************************************************** */
+
+static uint _nb_processors(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+}
+
+/* ************************************************************************** */
+
+uint64_t game_nb_solutions_parallel(cgame g, uint nb_threads) {
+    if (nb_threads == 0) nb_threads = _nb_processors();
+    if (nb_threads == 1) return game_nb_solutions_stats(g, NULL);
+
+    solver* s = solver_new(g);
+    if (!s) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // split deep enough to get several subtrees per thread
+    uint8_t* subtrees = NULL;
+    uint nb_subtrees = 0;
+    uint64_t nb_solutions = 0;
+    for (uint depth = 1; depth <= MAX_SPLIT_DEPTH; depth++) {
+        uint nb;
+        uint64_t found;
+        uint8_t* split = solver_split(s, depth, &nb, &found);
+        if (depth > 1 && nb <= nb_subtrees) {
+            // the tree did not grow anymore, keep the previous split
+            free(split);
+            break;
+        }
+        free(subtrees);
+        subtrees = split;
+        nb_subtrees = nb;
+        nb_solutions = found;
+        if (nb_subtrees == 0 || nb_subtrees >= SUBTREES_PER_THREAD * nb_threads) break;
+    }
+    solver_delete(s);
+
+    uint size = game_nb_rows(g) * game_nb_cols(g);
+    pool p = {g, subtrees, size, nb_threads, calloc(nb_threads, sizeof(worker))};
+    uint* tasks = malloc((nb_subtrees + 1) * sizeof(uint));
+    pthread_t* threads = malloc(nb_threads * sizeof(pthread_t));
+    if (!p.workers || !tasks || !threads) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // deal the subtrees round-robin, each worker owning a contiguous slice of tasks
+    uint next = 0;
+    for (uint w = 0; w < nb_threads; w++) {
+        worker* wk = &p.workers[w];
+        wk->p = &p;
+        wk->id = w;
+        pthread_mutex_init(&wk->deque.lock, NULL);
+        wk->deque.tasks = tasks + next;
+        wk->deque.head = 0;
+        wk->deque.tail = 0;
+        for (uint t = w; t < nb_subtrees; t += nb_threads) wk->deque.tasks[wk->deque.tail++] = t;
+        next += wk->deque.tail;
+    }
+
+    for (uint w = 0; w < nb_threads; w++) {
+        if (pthread_create(&threads[w], NULL, _worker_run, &p.workers[w]) != 0) {
+            fprintf(stderr, "Error creating thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    bool failed = false;
+    for (uint w = 0; w < nb_threads; w++) {
+        pthread_join(threads[w], NULL);
+        pthread_mutex_destroy(&p.workers[w].deque.lock);
+        nb_solutions += p.workers[w].nb_solutions;
+        failed = failed || p.workers[w].failed;
+    }
+    if (failed) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    free(threads);
+    free(tasks);
+    free(p.workers);
+    free(subtrees);
+    return nb_solutions;
+}
@@ -0,0 +1,596 @@
+#include "game.h"
+#include "game_ext.h"
+#include "game_struct.h"
+#include "game_tools.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// @copyright University of Bordeaux. All rights reserved, 2024.
+
+/**
+ * @brief SAT backend of the solver.
+ * @details Each edge between two squares is a boolean variable, as well as
+ * each distinct orientation of each square (exactly one per square). An
+ * orientation implies the value of the four edges around its square, so the
+ * two half-edges of an edge always agree. The formula is solved by a small
+ * CDCL core (two watched literals, 1-UIP clause learning, VSIDS, phase saving
+ * and Luby restarts). Connectivity is not encoded: each time a model is found,
+ * its networks are computed and, if there are several of them, a cut is added
+ * for each one (at least one edge must leave it) before searching again.
+ */
+
+typedef uint lit; // 2 * var + 1 if negated
+
+#define LIT(v, neg) (2 * (v) + ((neg) ? 1 : 0))
+#define NEG(l) ((l) ^ 1)
+#define VAR(l) ((l) >> 1)
+
+#define DIR_MASK(d) (0b1000 >> (d))
+#define RESTART_UNIT 100
+#define VAR_DECAY 0.95
+
+/* ************************************************************************** */
+
+typedef struct {
+    uint size;
+    lit lits[]; // lits[0] is the literal implied by the clause
+} clause;
+
+typedef struct {
+    clause** data;
+    uint nb;
+    uint capacity;
+} clause_vec;
+
+typedef struct {
+    uint nb_vars;
+    clause_vec clauses; // every clause, to free them
+    clause_vec* watches; // watches[l]: clauses watching the literal l
+    int8_t* value;       // 0 undefined, 1 true, -1 false
+    bool* polarity;      // saved phase (true if last assigned negated)
+    uint* level;
+    clause** reason;
+    lit* trail;
+    uint nb_trail;
+    uint qhead;
+    uint* trail_lim; // start of each decision level in the trail
+    uint nb_levels;
+    double* activity;
+    double var_inc;
+    uint* heap; // binary max-heap of variables ordered by activity
+    int* heap_pos;
+    uint heap_size;
+    bool* seen;
+    lit* learnt; // buffer for conflict analysis
+    bool unsat;
+} sat;
+
+/* ************************************************************************** */
+
+static void _vec_push(clause_vec* v, clause* c) {
+    if (v->nb == v->capacity) {
+        uint capacity = v->capacity ? 2 * v->capacity : 4;
+        clause** data = realloc(v->data, capacity * sizeof(clause*));
+        if (!data) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        v->data = data;
+        v->capacity = capacity;
+    }
+    v->data[v->nb++] = c;
+}
+
+static int _value(const sat* s, lit l) { return (l & 1) ? -s->value[VAR(l)] : s->value[VAR(l)]; }
+
+/* ************************************************************************** */
+
+static void _heap_up(sat* s, uint k) {
+    uint v = s->heap[k];
+    while (k > 0) {
+        uint parent = (k - 1) / 2;
+        if (s->activity[v] <= s->activity[s->heap[parent]]) break;
+        s->heap[k] = s->heap[parent];
+        s->heap_pos[s->heap[k]] = k;
+        k = parent;
+    }
+    s->heap[k] = v;
+    s->heap_pos[v] = k;
+}
+
+static void _heap_down(sat* s, uint k) {
+    uint v = s->heap[k];
+    for (;;) {
+        uint child = 2 * k + 1;
+        if (child >= s->heap_size) break;
+        if (child + 1 < s->heap_size && s->activity[s->heap[child + 1]] > s->activity[s->heap[child]]) child++;
+        if (s->activity[s->heap[child]] <= s->activity[v]) break;
+        s->heap[k] = s->heap[child];
+        s->heap_pos[s->heap[k]] = k;
+        k = child;
+    }
+    s->heap[k] = v;
+    s->heap_pos[v] = k;
+}
+
+static void _heap_insert(sat* s, uint v) {
+    if (s->heap_pos[v] >= 0) return;
+    s->heap[s->heap_size] = v;
+    _heap_up(s, s->heap_size++);
+}
+
+static uint _heap_pop(sat* s) {
+    uint v = s->heap[0];
+    s->heap_pos[v] = -1;
+    if (--s->heap_size > 0) {
+        s->heap[0] = s->heap[s->heap_size];
+        _heap_down(s, 0);
+    }
+    return v;
+}
+
+static void _bump(sat* s, uint v) {
+    if ((s->activity[v] += s->var_inc) > 1e100) {
+        for (uint k = 0; k < s->nb_vars; k++) s->activity[k] *= 1e-100;
+        s->var_inc *= 1e-100;
+    }
+    if (s->heap_pos[v] >= 0) _heap_up(s, s->heap_pos[v]);
+}
+
+/* ************************************************************************** */
+
+static void _sat_delete(sat* s);
+
+static sat* _sat_new(uint nb_vars) {
+    sat* s = calloc(1, sizeof(sat));
+    if (!s) return NULL;
+    s->nb_vars = nb_vars;
+    s->watches = calloc(2 * nb_vars, sizeof(clause_vec));
+    s->value = calloc(nb_vars, sizeof(int8_t));
+    s->polarity = malloc(nb_vars * sizeof(bool));
+    s->level = calloc(nb_vars, sizeof(uint));
+    s->reason = calloc(nb_vars, sizeof(clause*));
+    s->trail = malloc(nb_vars * sizeof(lit));
+    s->trail_lim = malloc((nb_vars + 1) * sizeof(uint));
+    s->activity = calloc(nb_vars, sizeof(double));
+    s->heap = malloc(nb_vars * sizeof(uint));
+    s->heap_pos = malloc(nb_vars * sizeof(int));
+    s->seen = calloc(nb_vars, sizeof(bool));
+    s->learnt = malloc(nb_vars * sizeof(lit));
+    s->var_inc = 1.0;
+    if (!s->watches || !s->value || !s->polarity || !s->level || !s->reason || !s->trail || !s->trail_lim ||
+        !s->activity || !s->heap || !s->heap_pos || !s->seen || !s->learnt) {
+        _sat_delete(s);
+        return NULL;
+    }
+    for (uint v = 0; v < nb_vars; v++) {
+        s->polarity[v] = true;
+        s->heap_pos[v] = -1;
+        _heap_insert(s, v);
+    }
+    return s;
+}
+
+static void _sat_delete(sat* s) {
+    if (!s) return;
+    for (uint k = 0; k < s->clauses.nb; k++) free(s->clauses.data[k]);
+    free(s->clauses.data);
+    if (s->watches) {
+        for (uint l = 0; l < 2 * s->nb_vars; l++) free(s->watches[l].data);
+    }
+    free(s->watches);
+    free(s->value);
+    free(s->polarity);
+    free(s->level);
+    free(s->reason);
+    free(s->trail);
+    free(s->trail_lim);
+    free(s->activity);
+    free(s->heap);
+    free(s->heap_pos);
+    free(s->seen);
+    free(s->learnt);
+    free(s);
+}
+
+/* ************************************************************************** */
+
+static void _enqueue(sat* s, lit l, clause* reason) {
+    uint v = VAR(l);
+    s->value[v] = (l & 1) ? -1 : 1;
+    s->level[v] = s->nb_levels;
+    s->reason[v] = reason;
+    s->trail[s->nb_trail++] = l;
+}
+
+/** undoes all the assignments above a given decision level */
+static void _cancel_until(sat* s, uint level) {
+    if (s->nb_levels <= level) return;
+    for (uint k = s->nb_trail; k-- > s->trail_lim[level];) {
+        uint v = VAR(s->trail[k]);
+        s->value[v] = 0;
+        s->reason[v] = NULL;
+        s->polarity[v] = s->trail[k] & 1;
+        _heap_insert(s, v);
+    }
+    s->nb_trail = s->qhead = s->trail_lim[level];
+    s->nb_levels = level;
+}
+
+/** @return the conflicting clause, or NULL */
+static clause* _propagate(sat* s) {
+    while (s->qhead < s->nb_trail) {
+        lit false_lit = NEG(s->trail[s->qhead++]);
+        clause_vec* ws = &s->watches[false_lit];
+        uint i = 0, j = 0;
+        while (i < ws->nb) {
+            clause* c = ws->data[i++];
+            if (c->lits[0] == false_lit) {
+                c->lits[0] = c->lits[1];
+                c->lits[1] = false_lit;
+            }
+            if (_value(s, c->lits[0]) == 1) {
+                ws->data[j++] = c;
+                continue;
+            }
+            // look for a new literal to watch
+            bool moved = false;
+            for (uint k = 2; k < c->size && !moved; k++) {
+                if (_value(s, c->lits[k]) != -1) {
+                    c->lits[1] = c->lits[k];
+                    c->lits[k] = false_lit;
+                    _vec_push(&s->watches[c->lits[1]], c);
+                    moved = true;
+                }
+            }
+            if (moved) continue;
+            ws->data[j++] = c;
+            if (_value(s, c->lits[0]) == -1) {
+                while (i < ws->nb) ws->data[j++] = ws->data[i++];
+                ws->nb = j;
+                s->qhead = s->nb_trail;
+                return c;
+            }
+            _enqueue(s, c->lits[0], c);
+        }
+        ws->nb = j;
+    }
+    return NULL;
+}
+
+/** stores a clause of at least two literals and watches its first two ones */
+static clause* _attach(sat* s, const lit* lits, uint size) {
+    clause* c = malloc(sizeof(clause) + size * sizeof(lit));
+    if (!c) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    c->size = size;
+    memcpy(c->lits, lits, size * sizeof(lit));
+    _vec_push(&s->clauses, c);
+    _vec_push(&s->watches[lits[0]], c);
+    _vec_push(&s->watches[lits[1]], c);
+    return c;
+}
+
+/** adds a clause at decision level 0 (without its literals already false) */
+static void _add_clause(sat* s, const lit* lits, uint size) {
+    assert(s->nb_levels == 0);
+    if (s->unsat) return;
+    uint nb = 0;
+    for (uint k = 0; k < size; k++) {
+        int val = _value(s, lits[k]);
+        if (val == 1) return; // already satisfied
+        if (val == 0) s->learnt[nb++] = lits[k];
+    }
+    if (nb == 0) {
+        s->unsat = true;
+    } else if (nb == 1) {
+        _enqueue(s, s->learnt[0], NULL);
+        s->unsat = _propagate(s) != NULL;
+    } else {
+        _attach(s, s->learnt, nb);
+    }
+}
+
+/**
+ * @brief Learns the first-UIP clause of a conflict (stored in s->learnt).
+ * @return the size of the learnt clause, whose literal of highest level (below
+ * the current one) is moved to s->learnt[1]
+ */
+static uint _analyze(sat* s, clause* conflict) {
+    uint nb = 1, path = 0;
+    lit p = 0;
+    bool first = true;
+    uint index = s->nb_trail;
+    do {
+        for (uint k = first ? 0 : 1; k < conflict->size; k++) {
+            lit q = conflict->lits[k];
+            uint v = VAR(q);
+            if (!s->seen[v] && s->level[v] > 0) {
+                _bump(s, v);
+                s->seen[v] = true;
+                if (s->level[v] >= s->nb_levels) path++;
+                else s->learnt[nb++] = q;
+            }
+        }
+        first = false;
+        while (!s->seen[VAR(s->trail[--index])]);
+        p = s->trail[index];
+        conflict = s->reason[VAR(p)];
+        s->seen[VAR(p)] = false;
+    } while (--path > 0);
+    s->learnt[0] = NEG(p);
+
+    uint best = 1;
+    for (uint k = 1; k < nb; k++) {
+        s->seen[VAR(s->learnt[k])] = false;
+        if (s->level[VAR(s->learnt[k])] > s->level[VAR(s->learnt[best])]) best = k;
+    }
+    if (nb > 1) {
+        lit tmp = s->learnt[1];
+        s->learnt[1] = s->learnt[best];
+        s->learnt[best] = tmp;
+    }
+    s->var_inc /= VAR_DECAY;
+    return nb;
+}
+
+/** Luby sequence 1 1 2 1 1 2 4 1 1 2 ... */
+static uint _luby(uint x) {
+    uint size = 1, seq = 0;
+    while (size < x + 1) {
+        seq++;
+        size = 2 * size + 1;
+    }
+    while (size - 1 != x) {
+        size = (size - 1) >> 1;
+        seq--;
+        x = x % size;
+    }
+    return 1u << seq;
+}
+
+/**
+ * @brief Searches a model for a bounded number of conflicts.
+ * @return 1 if a model is found, -1 if the formula is unsatisfiable, 0 to
+ * restart
+ */
+static int _search(sat* s, uint max_conflicts) {
+    uint nb_conflicts = 0;
+    for (;;) {
+        clause* conflict = _propagate(s);
+        if (conflict) {
+            if (s->nb_levels == 0) return -1;
+            uint size = _analyze(s, conflict);
+            uint back = size > 1 ? s->level[VAR(s->learnt[1])] : 0;
+            _cancel_until(s, back);
+            if (size == 1) {
+                _enqueue(s, s->learnt[0], NULL);
+            } else {
+                _enqueue(s, s->learnt[0], _attach(s, s->learnt, size));
+            }
+            nb_conflicts++;
+            continue;
+        }
+        if (nb_conflicts >= max_conflicts) {
+            _cancel_until(s, 0);
+            return 0;
+        }
+        // decide the most active unassigned variable, with its saved phase
+        uint v = s->nb_vars;
+        while (s->heap_size > 0) {
+            uint u = _heap_pop(s);
+            if (s->value[u] == 0) {
+                v = u;
+                break;
+            }
+        }
+        if (v == s->nb_vars) return 1;
+        s->trail_lim[s->nb_levels++] = s->nb_trail;
+        _enqueue(s, LIT(v, s->polarity[v]), NULL);
+    }
+}
+
+/* ************************************************************************** */
+
+/** @brief Encoding of a game into boolean variables. */
+typedef struct {
+    cgame g;
+    uint size;
+    uint* first;     // first orientation variable of each square
+    uint8_t* nb;     // number of distinct orientations of each square
+    uint8_t* orient; // orientation of each orientation variable
+    uint* parent;    // union-find used to compute the networks of a model
+} encoding;
+
+/** edge variable behind the half-edge of a square in a direction */
+static uint _edge_var(const encoding* e, uint i, uint j, direction d) {
+    uint nb_rows = game_nb_rows(e->g), nb_cols = game_nb_cols(e->g);
+    switch (d) {
+        case NORTH:
+            return 2 * (((i + nb_rows - 1) % nb_rows) * nb_cols + j) + 1;
+        case SOUTH:
+            return 2 * (i * nb_cols + j) + 1;
+        case WEST:
+            return 2 * (i * nb_cols + (j + nb_cols - 1) % nb_cols);
+        default:
+            return 2 * (i * nb_cols + j);
+    }
+}
+
+static void _encode(encoding* e, sat* s) {
+    cgame g = e->g;
+    uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+    lit lits[NB_DIRS + 1];
+    for (uint i = 0; i < nb_rows; i++) {
+        for (uint j = 0; j < nb_cols; j++) {
+            uint sq = i * nb_cols + j, first = e->first[sq], nb = e->nb[sq];
+            shape sh = _game_shape(g, sq);
+            // borders of a non-wrapping grid
+            if (!game_is_wrapping(g)) {
+                lit east = LIT(2 * sq, true), south = LIT(2 * sq + 1, true);
+                if (j == nb_cols - 1) _add_clause(s, &east, 1);
+                if (i == nb_rows - 1) _add_clause(s, &south, 1);
+            }
+            // exactly one orientation
+            for (uint k = 0; k < nb; k++) lits[k] = LIT(first + k, false);
+            _add_clause(s, lits, nb);
+            for (uint k = 0; k < nb; k++) {
+                for (uint l = k + 1; l < nb; l++) {
+                    lit pair[2] = {LIT(first + k, true), LIT(first + l, true)};
+                    _add_clause(s, pair, 2);
+                }
+            }
+            for (direction d = NORTH; d < NB_DIRS; d++) {
+                uint edge = _edge_var(e, i, j, d);
+                // each orientation fixes the edge
+                for (uint k = 0; k < nb; k++) {
+                    bool has = _code[sh][e->orient[first + k]] & DIR_MASK(d);
+                    lit pair[2] = {LIT(first + k, true), LIT(edge, !has)};
+                    _add_clause(s, pair, 2);
+                }
+                // and the other way around (redundant, but propagates better)
+                for (uint value = 0; value < 2; value++) {
+                    uint n = 0;
+                    lits[n++] = LIT(edge, value);
+                    for (uint k = 0; k < nb; k++) {
+                        bool has = _code[sh][e->orient[first + k]] & DIR_MASK(d);
+                        if (has == (value == 1)) lits[n++] = LIT(first + k, false);
+                    }
+                    _add_clause(s, lits, n);
+                }
+            }
+        }
+    }
+}
+
+static uint _find(uint* parent, uint x) {
+    while (parent[x] != x) x = parent[x] = parent[parent[x]];
+    return x;
+}
+
+/**
+ * @brief Adds a cut for each network of the model, if there are several ones.
+ * @return the number of networks of the model
+ */
+static uint _add_cuts(encoding* e, sat* s) {
+    cgame g = e->g;
+    uint nb_cols = game_nb_cols(g);
+    for (uint sq = 0; sq < e->size; sq++) e->parent[sq] = sq;
+    for (uint sq = 0; sq < e->size; sq++) {
+        uint i = sq / nb_cols, j = sq % nb_cols;
+        if (s->value[2 * sq] == 1) {
+            e->parent[_find(e->parent, sq)] = _find(e->parent, i * nb_cols + (j + 1) % nb_cols);
+        }
+        if (s->value[2 * sq + 1] == 1) {
+            e->parent[_find(e->parent, sq)] = _find(e->parent, ((i + 1) % game_nb_rows(g)) * nb_cols + j);
+        }
+    }
+    uint nb_networks = 0;
+    for (uint sq = 0; sq < e->size; sq++) {
+        if (_game_shape(g, sq) != EMPTY && _find(e->parent, sq) == sq) nb_networks++;
+    }
+    if (nb_networks <= 1) return 1;
+
+    _cancel_until(s, 0);
+    lit* cut = malloc(2 * e->size * sizeof(lit));
+    if (!cut) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint root = 0; root < e->size; root++) {
+        if (_game_shape(g, root) == EMPTY || _find(e->parent, root) != root) continue;
+        // at least one edge must leave this network
+        uint nb = 0;
+        for (uint sq = 0; sq < e->size; sq++) {
+            uint i = sq / nb_cols, j = sq % nb_cols;
+            if (_game_shape(g, sq) == EMPTY) continue;
+            uint east = i * nb_cols + (j + 1) % nb_cols;
+            uint south = ((i + 1) % game_nb_rows(g)) * nb_cols + j;
+            bool in = _find(e->parent, sq) == root;
+            if (_game_shape(g, east) != EMPTY && in != (_find(e->parent, east) == root)) {
+                cut[nb++] = LIT(2 * sq, false);
+            }
+            if (_game_shape(g, south) != EMPTY && in != (_find(e->parent, south) == root)) {
+                cut[nb++] = LIT(2 * sq + 1, false);
+            }
+        }
+        _add_clause(s, cut, nb);
+    }
+    free(cut);
+    return nb_networks;
+}
+
+/* ************************************************************************** */
+
+bool game_solve_sat(game g) {
+    assert(g);
+    uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+    encoding e = {g, nb_rows * nb_cols, NULL, NULL, NULL, NULL};
+    e.first = malloc(e.size * sizeof(uint));
+    e.nb = malloc(e.size * sizeof(uint8_t));
+    e.orient = malloc((2 + NB_DIRS) * e.size * sizeof(uint8_t));
+    e.parent = malloc(e.size * sizeof(uint));
+    if (!e.first || !e.nb || !e.orient || !e.parent) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // two edge variables per square (east and south), then its orientations
+    uint nb_vars = 2 * e.size;
+    for (uint sq = 0; sq < e.size; sq++) {
+        shape sh = _game_shape(g, sq);
+        e.first[sq] = nb_vars;
+        e.nb[sq] = 0;
+        for (direction o = NORTH; o < NB_DIRS; o++) {
+            bool dup = false;
+            for (uint k = 0; k < e.nb[sq]; k++) dup = dup || _code[sh][e.orient[nb_vars + k]] == _code[sh][o];
+            if (!dup) e.orient[nb_vars + e.nb[sq]++] = o;
+        }
+        nb_vars += e.nb[sq];
+    }
+
+    sat* s = _sat_new(nb_vars);
+    if (!s) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    _encode(&e, s);
+
+    int status = 0;
+    for (uint restart = 0; !s->unsat;) {
+        status = _search(s, RESTART_UNIT * _luby(restart++));
+        if (status == -1) break;
+        if (status == 1) {
+            if (_add_cuts(&e, s) <= 1) break;
+            status = 0;
+        }
+    }
+
+    bool found = status == 1;
+    if (found) {
+        for (uint sq = 0; sq < e.size; sq++) {
+            uint i = sq / nb_cols, j = sq % nb_cols;
+            shape sh = _game_shape(g, sq);
+            for (uint k = 0; k < e.nb[sq]; k++) {
+                uint v = e.first[sq] + k;
+                // keep the current orientation when it is equivalent
+                if (s->value[v] == 1 && _code[sh][_game_orientation(g, sq)] != _code[sh][e.orient[v]]) {
+                    game_set_piece_orientation(g, i, j, e.orient[v]);
+                }
+            }
+        }
+    }
+
+    _sat_delete(s);
+    free(e.first);
+    free(e.nb);
+    free(e.orient);
+    free(e.parent);
+    return found;
+}
@@ -1,20 +1,147 @@
 #include "game.h"
 #include "game_aux.h"
-#include "queue/queue.h"
+#include "game_ext.h"
+#include <stddef.h>
+#include <stdint.h>
 
 #ifndef __GAME_STRUCT_H__
 #define __GAME_STRUCT_H__
 
+/**
+ * @brief Move history.
+ * @details The undo and redo stacks share a ring buffer of packed moves: the
+ * nb_undo moves from first can be undone, the nb_redo next ones are the
+ * cancelled moves, most recent first. Playing a move only resets nb_redo.
+ * The policy bounds the number of moves that can be undone and the size of
+ * the buffer (a power of 2 no larger than max_bytes).
+ */
+typedef struct {
+    uint32_t* moves; // ring buffer of capacity moves (see HISTORY_MOVE)
+    uint capacity;   // power of 2, 0 before the first move
+    uint first;      // oldest move
+    uint nb_undo;    // number of moves that can be undone
+    uint nb_redo;    // number of cancelled moves that can be redone
+    game_history_policy policy;
+} game_history;
+
+/** packs a move: index of the square and number of quarter turns (0 to 3) */
+#define HISTORY_MOVE(index, turns) ((uint32_t)(index) << 2 | (turns))
+#define HISTORY_INDEX(move) ((move) >> 2)
+#define HISTORY_TURNS(move) ((move) & 3)
+
+/**
+ * @brief Game structure.
+ * @details The structure, the half-edge planes and the cells come from a
+ * single allocation (in this order, so that the planes are aligned). The
+ * history buffer is only allocated by the first move. When game_copy_into needs a
+ * larger grid, the planes and the cells move to a separate block.
+ */
 struct game_s {
-    shape* s;
-    direction* d;
     uint nb_columns;
     uint nb_rows;
     bool wrapping;
-    queue* undo_stack; // Historique des coups
-    queue* redo_stack; // Historique des coups annulés
+    game_history history; // Historique des coups et des coups annulés
+    uint nb_mismatches;   // number of mismatched edges
+    bool connected;       // cached result of game_is_connected
+    bool connected_valid; // false when the cache must be recomputed
+    uint nb_words;        // number of 64-bit words per row in a half-edge plane
+    uint64_t* edges;      // NB_DIRS half-edge planes of nb_rows * nb_words words
+    uint8_t* cells;       // one byte per square: shape << 2 | orientation
+    size_t capacity;      // bytes available for the planes and the cells
+    void* storage;        // separate block of the planes and the cells (NULL if in the same block)
 };
 
 typedef struct game_s game_s;
 
+/**
+ * @name Unchecked accessors
+ * @details For the library and trusted callers: unlike game_get_piece_shape
+ * and game_get_piece_orientation, these inline functions check neither the
+ * game nor the index. Square (i,j) is at index i * nb_columns + j.
+ * @{
+ */
+
+/** cell of the square at a row-major index: shape << 2 | orientation */
+static inline uint8_t game_cell(cgame g, uint index) { return g->cells[index]; }
+
+/** shape of a cell */
+static inline shape game_cell_shape(uint8_t cell) { return cell >> 2; }
+
+/** orientation of a cell */
+static inline direction game_cell_orientation(uint8_t cell) { return cell & 3; }
+
+/** shape of the square at a row-major index */
+static inline shape _game_shape(cgame g, uint index) { return game_cell_shape(game_cell(g, index)); }
+
+/** orientation of the square at a row-major index */
+static inline direction _game_orientation(cgame g, uint index) { return game_cell_orientation(game_cell(g, index)); }
+
+/** @} */
+
+/** half-edge code of each piece (shape & orientation), defined in game_tools.c */
+extern const uint _code[NB_SHAPES][NB_DIRS];
+
+/**
+ * @brief Row @p i of the half-edge plane in direction @p d.
+ * @details The half-edges of the grid are stored as 4 bit planes (N-E-S-W),
+ * the same encoding as _code: bit j of a row is set if the square in column j
+ * has a half-edge in this direction. Unused bits of the last word are zero.
+ */
+static inline uint64_t* _game_plane(cgame g, direction d, uint i) {
+    return g->edges + ((size_t)d * g->nb_rows + i) * g->nb_words;
+}
+
+/** tests the half-edge of square (i,j) in direction d, without any check */
+static inline bool _game_half_edge(cgame g, uint i, uint j, direction d) {
+    return (_game_plane(g, d, i)[j / 64] >> (j % 64)) & 1;
+}
+
+/**
+ * @brief Allocates a game in one block: empty squares facing north, no history.
+ * @return the game, or NULL if the allocation failed
+ */
+game _game_alloc(uint nb_rows, uint nb_cols, bool wrapping);
+
+/** move k of the history, counted from the oldest one */
+static inline uint32_t* _game_history_at(cgame g, uint k) {
+    return &g->history.moves[(g->history.first + k) & (g->history.capacity - 1)];
+}
+
+/** records a played move and forgets the cancelled ones */
+void _game_history_push(game g, uint32_t move);
+
+/** drops the oldest moves and shrinks the buffer to comply with the policy */
+void _game_history_fit(game g);
+
+/** number of bytes of the half-edge planes and of the cells of a grid */
+size_t _game_storage_size(uint nb_rows, uint nb_cols);
+
+/** rebuilds the half-edge planes and the win-detection data from the grid */
+void _game_rebuild(game g);
+
+/** instruction sets of the edge validation kernel (see game_simd.c) */
+typedef enum {
+    SIMD_SCALAR = 0, /**< portable 64-bit words */
+    SIMD_SSE2,       /**< 128-bit vectors */
+    SIMD_AVX2,       /**< 256-bit vectors */
+} simd_level;
+
+/** best instruction set supported by the processor */
+simd_level _game_simd_level(void);
+
+/** number of mismatched edges of the whole grid, computed word by word */
+uint _game_edge_mismatches(cgame g);
+
+/** same, with at most the given instruction set */
+uint _game_edge_mismatches_with(cgame g, simd_level level);
+
+/** number of mismatched edges around a square (each edge is counted once) */
+uint _game_local_mismatches(cgame g, uint i, uint j);
+
+/** changes a square and updates the number of mismatched edges locally */
+void _game_set_square(game g, uint i, uint j, shape s, direction o);
+
+/** refreshes the cached connectivity if the grid is well paired */
+void _game_update_won(game g);
+
 #endif
\ No newline at end of file
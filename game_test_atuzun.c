@@ -119,6 +119,16 @@ bool test_game_won(void) {
     if (!game_won(g6)) return false;
     if (!game_won(g7)) return false;
 
+    // the win state must follow the moves, undo and redo
+    game_play_move(g1, 0, 0, 1);
+    if (game_won(g1)) return false;
+    game_undo(g1);
+    if (!game_won(g1)) return false;
+    game_redo(g1);
+    if (game_won(g1)) return false;
+    game_set_piece_orientation(g1, 0, 0, EAST);
+    if (!game_won(g1)) return false;
+
     game_delete(g1); game_delete(g2); game_delete(g3); game_delete(g4);
     game_delete(g5); game_delete(g6); game_delete(g7);
     return true;
@@ -201,6 +211,83 @@ bool test_game_redo(void) {
     return result1 && result2;
 }
 
+bool test_game_history(void) {
+    game g = game_default();
+    game g_default = game_default();
+    bool result = game_history_memory(g) == 0;
+    // a long replay, then undoing everything
+    for (uint k = 0; k < 100000; k++) game_play_move(g, k % 5, k / 5 % 5, k % 7 - 3);
+    result = result && game_history_memory(g) >= 100000 * sizeof(uint32_t);
+    for (uint k = 0; k < 100000; k++) game_undo(g);
+    result = result && game_equal(g, g_default, false);
+    for (uint k = 0; k < 100000; k++) game_redo(g);
+    for (uint k = 0; k < 100000; k++) game_undo(g);
+    result = result && game_equal(g, g_default, false);
+
+    // only the last moves are kept with a maximum depth
+    game_set_history_depth(g, 3);
+    game_play_move(g, 0, 0, 1);
+    game game_one = game_copy(g);
+    game_play_move(g, 0, 1, 1);
+    game_play_move(g, 0, 2, 1);
+    game_play_move(g, 0, 3, 1);
+    for (uint k = 0; k < 5; k++) game_undo(g);
+    result = result && game_equal(g, game_one, false);
+    game_redo(g);
+    game_redo(g);
+    game_redo(g);
+    game_set_history_depth(g, 1);
+    game_undo(g);
+    game_undo(g);
+    game_redo(g);
+    result = result && game_get_piece_orientation(g, 0, 3) == (game_get_piece_orientation(g_default, 0, 3) + 1) % NB_DIRS;
+    result = result && game_get_piece_orientation(g, 0, 2) == (game_get_piece_orientation(g_default, 0, 2) + 1) % NB_DIRS;
+    game_delete(g);
+    game_delete(g_default);
+    game_delete(game_one);
+    return result;
+}
+
+bool test_game_history_policy(void) {
+    game g = game_default();
+    game g_default = game_default();
+    game_history_policy policy = {true, 0, 0};
+    game_set_history_policy(g, &policy);
+    bool result = game_get_history_policy(g).coalesce;
+
+    // three clicks on a square are undone at once, four clicks leave nothing
+    game_play_move(g, 0, 0, 1);
+    game_play_move(g, 0, 0, 1);
+    game_play_move(g, 0, 0, 1);
+    game_play_move(g, 1, 1, 1);
+    for (uint k = 0; k < 4; k++) game_play_move(g, 2, 2, 1);
+    game_play_move(g, 3, 3, 0);
+    game_undo(g);
+    result = result && game_get_piece_orientation(g, 1, 1) == game_get_piece_orientation(g_default, 1, 1);
+    game_undo(g);
+    result = result && game_equal(g, g_default, false);
+    game_redo(g);
+    result = result && game_get_piece_orientation(g, 0, 0) == (game_get_piece_orientation(g_default, 0, 0) + 3) % NB_DIRS;
+    game_undo(g);
+
+    // the history buffer stays within max_bytes
+    policy = (game_history_policy){true, 0, 256};
+    game_set_history_policy(g, &policy);
+    for (uint k = 0; k < 10000; k++) game_play_move(g, k % 5, k / 5 % 5, 1);
+    result = result && game_history_memory(g) <= 256;
+    // every square has made full turns, but only the last 64 moves are undone
+    for (uint k = 0; k < 10000; k++) game_undo(g);
+    result = result && !game_equal(g, g_default, false);
+
+    // max_moves and max_bytes are both applied, the buffer shrinks at once
+    policy = (game_history_policy){false, 100, 64};
+    game_set_history_policy(g, &policy);
+    result = result && game_history_memory(g) <= 64;
+    game_delete(g);
+    game_delete(g_default);
+    return result;
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         return EXIT_FAILURE;
@@ -227,6 +314,10 @@ int main(int argc, char* argv[]) {
         ok = test_game_shuffle_orientation();
     } else if (strcmp("game_print", argv[1]) == 0) {
         ok = test_game_print();
+    } else if (strcmp("game_history", argv[1]) == 0) {
+        ok = test_game_history();
+    } else if (strcmp("game_history_policy", argv[1]) == 0) {
+        ok = test_game_history_policy();
     } else if (strcmp("game_undo", argv[1]) == 0) {
         ok = test_game_undo();
     } else if (strcmp("game_redo", argv[1]) == 0) {
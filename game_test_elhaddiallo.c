@@ -80,6 +80,31 @@ bool test_copy() {
     return result && result2; // Return true if both games are equal
 }
 
+bool test_game_copy_into(void) {
+    game small = game_default();
+    game big = game_random(12, 20, true, 0, 4);
+    game_shuffle_orientation(big);
+    game dst = game_new_empty();
+    game_play_move(dst, 0, 0, 1);
+    // growing, then reusing the storage with smaller and same-size grids
+    game_copy_into(dst, big);
+    bool result = game_equal(dst, big, false) && game_won(dst) == game_won(big);
+    game_copy_into(dst, small);
+    result = result && game_equal(dst, small, false) && game_nb_rows(dst) == 5 && !game_is_wrapping(dst);
+    game_copy_into(dst, big);
+    result = result && game_equal(dst, big, false);
+    // the history is cleared
+    game_undo(dst);
+    result = result && game_equal(dst, big, false);
+    game_solve(big);
+    game_copy_into(dst, big);
+    result = result && game_won(dst);
+    game_delete(small);
+    game_delete(big);
+    game_delete(dst);
+    return result;
+}
+
 bool test_game_equal(void) {
     game g1 = game_default();
     game g2 = game_default_solution();
@@ -262,6 +287,78 @@ bool test_game_save(void) {
     return result;
 }
 
+bool test_game_save_binary(void) {
+    const char* filename = "test_game_save" GAME_BINARY_EXT;
+    shape shapes[] = {ENDPOINT, TEE, CROSS, SEGMENT, CORNER, EMPTY};
+    direction orientations[] = {SOUTH, WEST, NORTH, EAST, SOUTH, WEST};
+    game g1 = game_new_ext(2, 3, shapes, orientations, true);
+    game_save(g1, (char*)filename); // the extension selects the binary format
+
+    FILE* f = fopen(filename, "rb");
+    char magic[5] = {0};
+    bool result = f && fread(magic, 1, 4, f) == 4 && strcmp(magic, "NETB") == 0 && fseek(f, 0, SEEK_END) == 0 && ftell(f) == 16 + 6;
+    if (f) fclose(f);
+
+    game g2 = game_load((char*)filename);
+    game g3 = game_load_binary(filename);
+    result = result && game_equal(g1, g2, false) && game_is_wrapping(g2) && game_equal(g1, g3, false);
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    remove(filename);
+    return result;
+}
+
+bool test_game_archive(void) {
+    const char* filename = "test_game_archive" GAME_ARCHIVE_EXT;
+    remove(filename);
+    game games[5];
+    for (uint k = 0; k < 5; k++) {
+        games[k] = game_new_empty_ext(2 + k, 3, k % 2);
+        game_set_piece_shape(games[k], k, 1, TEE);
+        game_set_piece_orientation(games[k], k, 1, k % NB_DIRS);
+    }
+
+    // written in two sessions: the second one appends to the first
+    bool result = true;
+    for (uint part = 0; part < 2; part++) {
+        game_archive a = game_archive_open(filename, true);
+        result = result && a;
+        for (uint k = 3 * part; k < (part ? 5 : 3) && result; k++) result = game_archive_append(a, games[k]);
+        result = game_archive_close(a) && result;
+    }
+
+    game_archive a = game_archive_open(filename, false);
+    result = result && a && game_archive_nb_games(a) == 5;
+    for (uint k = 0; k < 5 && result; k++) {
+        // random access backwards, sequential access forwards
+        game g1 = game_archive_get(a, 4 - k);
+        game g2 = game_archive_next(a);
+        result = g1 && g2 && game_equal(g1, games[4 - k], false) && game_is_wrapping(g1) == (4 - k) % 2 &&
+                 game_equal(g2, games[k], false);
+        if (g1) game_delete(g1);
+        if (g2) game_delete(g2);
+    }
+    result = result && !game_archive_next(a) && !game_archive_error(a) && !game_archive_get(a, 5);
+    game_archive_close(a);
+
+    // an invalid shape in game 2 (at 8 + 22 + 25, after the 8-byte archive header and the first games)
+    FILE* f = fopen(filename, "r+b");
+    result = result && f && fseek(f, 8 + 22 + 25 + 16, SEEK_SET) == 0 && fputc(0xfc, f) == 0xfc;
+    if (f) fclose(f);
+    a = game_archive_open(filename, false);
+    for (uint k = 0; k < 2 && result; k++) {
+        game g = game_archive_next(a);
+        result = g && game_equal(g, games[k], false);
+        if (g) game_delete(g);
+    }
+    result = result && !game_archive_next(a) && game_archive_error(a);
+    game_archive_close(a);
+    for (uint k = 0; k < 5; k++) game_delete(games[k]);
+    remove(filename);
+    return result;
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         fprintf(stderr, "Usage: %s <test_name>\n", argv[0]);
@@ -272,6 +369,7 @@ int main(int argc, char* argv[]) {
     else if (strcmp(argv[1], "game_new_empty") == 0) return test_game_new_empty() ? EXIT_SUCCESS : EXIT_FAILURE;
     else if (strcmp(argv[1], "game_new") == 0) return test_game_new() ? EXIT_SUCCESS : EXIT_FAILURE;
     else if (strcmp(argv[1], "game_copy") == 0) return test_copy() ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (strcmp(argv[1], "game_copy_into") == 0) return test_game_copy_into() ? EXIT_SUCCESS : EXIT_FAILURE;
     else if (strcmp(argv[1], "game_equal") == 0) return test_game_equal() ? EXIT_SUCCESS : EXIT_FAILURE;
     else if (strcmp(argv[1], "game_delete") == 0) return test_game_delete() ? EXIT_SUCCESS : EXIT_FAILURE;
     else if (strcmp(argv[1], "game_set_piece_shape") == 0) return test_game_set_piece_shape() ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -279,6 +377,8 @@ int main(int argc, char* argv[]) {
     else if (strcmp(argv[1], "game_new_ext") == 0) return test_game_new_ext() ? EXIT_SUCCESS : EXIT_FAILURE;
     else if (strcmp(argv[1], "game_new_empty_ext") == 0) return test_game_new_empty_ext() ? EXIT_SUCCESS : EXIT_FAILURE;
     else if (strcmp(argv[1], "game_save") == 0) return test_game_save() ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (strcmp(argv[1], "game_save_binary") == 0) return test_game_save_binary() ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (strcmp(argv[1], "game_archive") == 0) return test_game_archive() ? EXIT_SUCCESS : EXIT_FAILURE;
     else {
         fprintf(stderr, "Invalid argument: %s\n", argv[1]);
         return EXIT_FAILURE;
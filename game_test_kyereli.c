@@ -1,6 +1,7 @@
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_struct.h"
 #include "game_tools.h"
 #include "queue/queue.h"
 #include <stdio.h>
@@ -112,6 +113,28 @@ bool test_game_is_well_paired(void) {
     return result && result2 && result3 && result4 && result5 && result6 && result7;
 }
 
+bool test_game_check_edges(void) {
+    game g1 = game_default_solution();
+    game g2 = game_default();
+    uint nb1, nb2;
+    bool result1 = game_check_edges(g1, &nb1) && nb1 == 0;
+    bool result2 = !game_check_edges(g2, &nb2) && nb2 > 0;
+    game_delete(g1);
+    game_delete(g2);
+
+    // every instruction set must agree on large grids, wrapping or not
+    bool result3 = true;
+    for (uint k = 0; k < 8 && result3; k++) {
+        game g = game_random(3 + k, 64 * k + 37, k % 2, k, 0);
+        for (uint n = 0; n < 20; n++) game_play_move(g, n % (3 + k), (7 * n) % (64 * k + 37), 1);
+        uint nb = _game_edge_mismatches_with(g, SIMD_SCALAR);
+        game_check_edges(g, &nb1);
+        result3 = nb == nb1 && nb == _game_edge_mismatches_with(g, SIMD_SSE2) && nb == _game_edge_mismatches_with(g, SIMD_AVX2);
+        game_delete(g);
+    }
+    return result1 && result2 && result3;
+}
+
 bool test_game_is_connected(void) {
     direction orientations[DEFAULT_SIZE * DEFAULT_SIZE] = {EAST, EAST, EAST, EAST, SOUTH, EAST, EAST, EAST, EAST, WEST, NORTH, EAST, EAST, EAST, SOUTH, EAST, WEST, WEST, WEST, WEST, NORTH, EAST, EAST, EAST, WEST};
     shape shapes[DEFAULT_SIZE * DEFAULT_SIZE] = {ENDPOINT, SEGMENT, SEGMENT, SEGMENT, CORNER, CORNER, SEGMENT, SEGMENT, SEGMENT, CORNER, CORNER, SEGMENT, SEGMENT, SEGMENT, CORNER, CORNER, SEGMENT, SEGMENT, SEGMENT, CORNER, CORNER, SEGMENT, SEGMENT, SEGMENT, ENDPOINT};
@@ -134,6 +157,21 @@ bool test_game_is_connected(void) {
     return result1 && result2 && result3 && result4;
 }
 
+bool test_game_nb_components(void) {
+    shape shapes[] = {ENDPOINT, ENDPOINT, ENDPOINT, ENDPOINT};
+    direction orientations[] = {EAST, WEST, EAST, WEST};
+    game g1 = game_default_solution();
+    game g2 = game_new_empty_ext(30, 40, false);
+    game g3 = game_new_ext(1, 4, shapes, orientations, false);
+    bool result1 = game_nb_components(g1) == 1;
+    bool result2 = game_nb_components(g2) == 0 && game_is_connected(g2);
+    bool result3 = game_nb_components(g3) == 2 && !game_is_connected(g3);
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    return result1 && result2 && result3;
+}
+
 bool test_game_nb_rows(void) {
     game g1 = game_new_empty();
     game g2 = game_new_empty_ext(3, 4, true);
@@ -172,6 +210,244 @@ bool test_game_load(void) {
     return result1;
 }
 
+bool test_game_parse(void) {
+    // two games one after the other, with the same spacing as game_save
+    const char* text = "1 3 0\nNE SW NW \n2 1 1\nCS\nX N\n";
+    size_t len = strlen(text), pos = 0;
+    game_parse_error error;
+    game g1 = game_parse(text, len, &pos, &error);
+    game g2 = game_parse(text, len, &pos, &error);
+    bool result1 = g1 && g2 && game_nb_cols(g1) == 3 && game_get_piece_shape(g1, 0, 1) == SEGMENT &&
+                   game_get_piece_orientation(g1, 0, 2) == WEST && game_is_wrapping(g2) && game_get_piece_shape(g2, 1, 0) == CROSS;
+    bool result2 = !game_parse(text, len, &pos, &error) && strcmp(error.message, "nombre de lignes attendu") == 0;
+
+    // errors are located by line and column
+    const char* bad = "2 2 0\nNE SS\nCQ TW\n";
+    pos = 0;
+    bool result3 = !game_parse(bad, strlen(bad), &pos, &error) && error.line == 3 && error.col == 2 && pos == 0;
+    const char* short_text = "2 2 0\nNE SS\nCN";
+    bool result4 = !game_parse(short_text, strlen(short_text), &pos, &error) && error.line == 3 && error.col == 3;
+
+    // a huge header without its data is rejected before allocating the grid
+    const char* huge = "65535 65535 0\nNE\n";
+    bool result5 = !game_parse(huge, strlen(huge), &pos, &error) && strcmp(error.message, "données manquantes") == 0 &&
+                   error.pos == strlen(huge) && error.line == 3 && error.col == 1;
+    if (g1) game_delete(g1);
+    if (g2) game_delete(g2);
+    return result1 && result2 && result3 && result4 && result5;
+}
+
+bool test_game_solve(void) {
+    game g1 = game_default();
+    shape shapes[] = {ENDPOINT, ENDPOINT, ENDPOINT};
+    game g2 = game_new_ext(1, 3, shapes, NULL, false);
+    bool result1 = game_solve(g1) && game_won(g1);
+    bool result2 = !game_solve(g2);
+    game_delete(g1);
+    game_delete(g2);
+    return result1 && result2;
+}
+
+bool test_game_solve_sat(void) {
+    game g1 = game_default();
+    shape shapes[] = {ENDPOINT, ENDPOINT, ENDPOINT};
+    game g2 = game_new_ext(1, 3, shapes, NULL, false);
+    shape corners[] = {CORNER, CORNER, CORNER, CORNER, CORNER, CORNER, CORNER, CORNER};
+    game g3 = game_new_ext(2, 4, corners, NULL, false);
+    game g4 = game_copy(g3);
+    shape ring[] = {CORNER, SEGMENT, CORNER, CORNER, SEGMENT, CORNER};
+    game g5 = game_new_ext(2, 3, ring, NULL, true);
+    bool result1 = game_solve_sat(g1) && game_won(g1);
+    bool result2 = !game_solve_sat(g2);
+    // two separate loops only: the connectivity cut makes it unsatisfiable
+    bool result3 = !game_solve_sat(g3) && game_equal(g3, g4, false);
+    bool result4 = game_solve_sat(g5) && game_won(g5);
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    game_delete(g4);
+    game_delete(g5);
+    return result1 && result2 && result3 && result4;
+}
+
+static bool is_cancelled(void* data) { return *(int*)data != 0; }
+
+bool test_game_solve_until(void) {
+    game g1 = game_default();
+    game g2 = game_default();
+    game g3 = game_default();
+    game g4 = game_default();
+    shape shapes[] = {ENDPOINT, ENDPOINT, ENDPOINT};
+    game g5 = game_new_ext(1, 3, shapes, NULL, false);
+    int cancel = 0;
+    bool result1 = game_solve_until(g1, is_cancelled, &cancel, 0) == SOLVE_FOUND && game_won(g1);
+    bool result2 = game_solve_until(g5, NULL, NULL, 10) == SOLVE_NONE;
+    cancel = 1;
+    bool result3 = game_solve_until(g2, is_cancelled, &cancel, 0) == SOLVE_CANCELLED && game_equal(g2, g4, false);
+    bool result4 = game_solve_until(g3, NULL, NULL, 1e-9) == SOLVE_TIMEOUT && game_equal(g3, g4, false);
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    game_delete(g4);
+    game_delete(g5);
+    return result1 && result2 && result3 && result4;
+}
+
+bool test_game_solve_stats(void) {
+    game g1 = game_default();
+    shape shapes[] = {ENDPOINT, ENDPOINT, ENDPOINT};
+    game g2 = game_new_ext(1, 3, shapes, NULL, false);
+    shape ring[] = {CORNER, SEGMENT, CORNER, CORNER, SEGMENT, CORNER};
+    game g3 = game_new_ext(2, 3, ring, NULL, true);
+    game_stats st1, st2, st3;
+    bool result1 = game_solve_stats(g1, &st1) && game_won(g1) && st1.nb_nodes >= 1 && st1.time >= 0;
+    bool result2 = !game_solve_stats(g2, &st2) && st2.nb_nodes == 1 &&
+                   st2.nb_prunes[PRUNE_EDGE] + st2.nb_prunes[PRUNE_BORDER] + st2.nb_prunes[PRUNE_CONNECTIVITY] == 1 &&
+                   st2.nb_backtracks[0] == 1;
+    bool result3 = game_nb_solutions_stats(g3, &st3) == 4 && st3.nb_nodes > 1 && st3.max_depth >= 1;
+
+    // control characters of the name must be escaped in JSON
+    char line[256] = "";
+    FILE* f = tmpfile();
+    if (f) {
+        game_stats_print(f, "a\"b\\c\nd\te\x01", &st2, true);
+        rewind(f);
+        if (!fgets(line, sizeof(line), f)) line[0] = '\0';
+        fclose(f);
+    }
+    const char* expected = "{\"name\":\"a\\\"b\\\\c\\nd\\te\\u0001\",\"nodes\":1,";
+    bool result4 = strncmp(line, expected, strlen(expected)) == 0;
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    return result1 && result2 && result3 && result4;
+}
+
+bool test_game_rate(void) {
+    game g1 = game_default();
+    game g2 = game_default();
+    shape shapes[] = {ENDPOINT, ENDPOINT, ENDPOINT};
+    game g3 = game_new_ext(1, 3, shapes, NULL, false);
+    game_rating r1, r2, r3;
+    bool result1 = game_rate(g1, &r1) && r1.tier == DIFFICULTY_EASY && r1.nb_decisions == 0 && r1.nb_forced == r1.nb_open &&
+                   game_equal(g1, g2, false) && strcmp(game_difficulty_name(r1.tier), "easy") == 0;
+    bool result2 = !game_rate(g3, &r3);
+
+    // the decisions are the nodes of the search, but its root
+    game_rng rng;
+    game_rng_seed(&rng, 16);
+    game g4 = game_random_r(20, 20, true, 0, 6, &rng);
+    game_shuffle_orientation_r(g4, &rng);
+    game_stats st;
+    game_solve_stats(g4, &st);
+    bool result3 = game_rate(g4, &r2) && r2.nb_decisions == st.nb_nodes - 1 && r2.nb_forced <= r2.nb_open &&
+                   r2.max_backtrack <= st.max_depth && (r2.tier == DIFFICULTY_EASY) == (r2.nb_decisions == 0);
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    game_delete(g4);
+    return result1 && result2 && result3;
+}
+
+bool test_game_nb_solutions(void) {
+    game g1 = game_default();
+    game g2 = game_default();
+    game g3 = game_new_empty_ext(3, 3, true);
+    shape shapes[] = {SEGMENT, SEGMENT, SEGMENT};
+    game g4 = game_new_ext(1, 3, shapes, NULL, true);
+    bool result1 = game_nb_solutions(g1) == 1 && game_equal(g1, g2, false);
+    bool result2 = game_nb_solutions(g3) == 1;
+    bool result3 = game_nb_solutions(g4) == 1;
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    game_delete(g4);
+    return result1 && result2 && result3;
+}
+
+bool test_game_nb_solutions_parallel(void) {
+    game g1 = game_default();
+    shape shapes[] = {CORNER, SEGMENT, CORNER, CORNER, SEGMENT, CORNER};
+    game g2 = game_new_ext(2, 3, shapes, NULL, true);
+    bool result1 = game_nb_solutions_parallel(g1, 4) == 1;
+    bool result2 = game_nb_solutions_parallel(g2, 3) == 4 && game_nb_solutions(g2) == 4;
+    game_delete(g1);
+    game_delete(g2);
+    return result1 && result2;
+}
+
+bool test_game_nb_solutions_frontier(void) {
+    game g1 = game_default();
+    game g2 = game_new_empty_ext(3, 3, false);
+    shape shapes[] = {CORNER, SEGMENT, CORNER, CORNER, SEGMENT, CORNER};
+    game g3 = game_new_ext(2, 3, shapes, NULL, false);
+    shape shapes_t[] = {CORNER, CORNER, SEGMENT, SEGMENT, CORNER, CORNER};
+    game g4 = game_new_ext(3, 2, shapes_t, NULL, false);
+    game g5 = game_new_ext(2, 3, shapes, NULL, true);
+    uint64_t nb1 = 0, nb2 = 0, nb3 = 0, nb4 = 0, nb5 = 0;
+    bool result1 = game_nb_solutions_frontier(g1, &nb1) && nb1 == 1 && nb1 == game_nb_solutions(g1);
+    bool result2 = game_nb_solutions_frontier(g2, &nb2) && nb2 == 1;
+    bool result3 = game_nb_solutions_frontier(g3, &nb3) && nb3 == 1;
+    bool result4 = game_nb_solutions_frontier(g4, &nb4) && nb4 == 1;
+    bool result5 = !game_nb_solutions_frontier(g5, &nb5) && nb5 == 0;
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    game_delete(g4);
+    game_delete(g5);
+    return result1 && result2 && result3 && result4 && result5;
+}
+
+bool test_game_random_r(void) {
+    game_rng rng1, rng2;
+    game_rng_seed(&rng1, 42);
+    game_rng_seed(&rng2, 42);
+    bool result = true;
+    for (uint k = 0; k < 1000 && result; k++) {
+        uint x = game_rng_below(&rng1, k + 1);
+        result = x <= k && x == game_rng_below(&rng2, k + 1) && game_rng_next(&rng1) == game_rng_next(&rng2);
+    }
+
+    // same seed, same game; the global rand() state is not used
+    game_rng_seed(&rng1, 7);
+    game_rng_seed(&rng2, 7);
+    game g1 = game_random_r(12, 9, true, 5, 3, &rng1);
+    srand(1);
+    game g2 = game_random_r(12, 9, true, 5, 3, &rng2);
+    game_shuffle_orientation_r(g1, &rng1);
+    game_shuffle_orientation_r(g2, &rng2);
+    result = result && game_equal(g1, g2, false) && game_nb_solutions(g1) >= 1;
+    game g3 = game_random_r(12, 9, true, 5, 3, &rng1);
+    result = result && !game_equal(g1, g3, false);
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    return result;
+}
+
+bool test_game_random_unique(void) {
+    bool result = true;
+    for (uint k = 0; k < 12 && result; k++) {
+        srand(k);
+        uint nb_rows = 3 + k % 4, nb_cols = 4 + k % 3, nb_empty = k % 3;
+        game_random_stats stats;
+        game g = game_random_unique(nb_rows, nb_cols, k % 2, nb_empty, k % 2, &stats);
+        if (!g) return false;
+        uint nb = 0;
+        for (uint i = 0; i < nb_rows; i++)
+            for (uint j = 0; j < nb_cols; j++) nb += game_get_piece_shape(g, i, j) == EMPTY;
+        result = game_won(g) && nb == nb_empty && stats.nb_attempts >= 1;
+        game_shuffle_orientation(g);
+        result = result && game_nb_solutions(g) == 1;
+        game_delete(g);
+    }
+
+    // with two wrapping rows, north and south lead to the same neighbor: flipping
+    // all the vertical half-edges always gives a second solution
+    game g = game_random_unique(2, 5, true, 0, 0, NULL);
+    return result && !g;
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         return EXIT_FAILURE;
@@ -194,8 +470,12 @@ int main(int argc, char* argv[]) {
         ok = test_game_check_edge();
     else if (strcmp("game_is_well_paired", argv[1]) == 0)
         ok = test_game_is_well_paired();
+    else if (strcmp("game_check_edges", argv[1]) == 0)
+        ok = test_game_check_edges();
     else if (strcmp("game_is_connected", argv[1]) == 0)
         ok = test_game_is_connected();
+    else if (strcmp("game_nb_components", argv[1]) == 0)
+        ok = test_game_nb_components();
     else if (strcmp("game_nb_rows", argv[1]) == 0)
         ok = test_game_nb_rows();
     else if (strcmp("game_nb_cols", argv[1]) == 0)
@@ -204,6 +484,28 @@ int main(int argc, char* argv[]) {
         ok = test_game_is_wrapping();
     else if (strcmp("game_load", argv[1]) == 0)
         ok = test_game_load();
+    else if (strcmp("game_parse", argv[1]) == 0)
+        ok = test_game_parse();
+    else if (strcmp("game_solve", argv[1]) == 0)
+        ok = test_game_solve();
+    else if (strcmp("game_solve_sat", argv[1]) == 0)
+        ok = test_game_solve_sat();
+    else if (strcmp("game_solve_until", argv[1]) == 0)
+        ok = test_game_solve_until();
+    else if (strcmp("game_solve_stats", argv[1]) == 0)
+        ok = test_game_solve_stats();
+    else if (strcmp("game_rate", argv[1]) == 0)
+        ok = test_game_rate();
+    else if (strcmp("game_nb_solutions", argv[1]) == 0)
+        ok = test_game_nb_solutions();
+    else if (strcmp("game_nb_solutions_parallel", argv[1]) == 0)
+        ok = test_game_nb_solutions_parallel();
+    else if (strcmp("game_nb_solutions_frontier", argv[1]) == 0)
+        ok = test_game_nb_solutions_frontier();
+    else if (strcmp("game_random_r", argv[1]) == 0)
+        ok = test_game_random_r();
+    else if (strcmp("game_random_unique", argv[1]) == 0)
+        ok = test_game_random_unique();
     else {
         fprintf(stderr, "Error: test \"%s\" not found!\n", argv[1]);
         return EXIT_FAILURE;
@@ -30,6 +30,7 @@ int main(int argc, char* argv[]) {
     if (argc == 2) {
         char* filename = argv[1];
         g = game_load(filename);
+        if (!g) exit(EXIT_FAILURE);
     } else {
         g = game_default();
     }
@@ -1,15 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "game_tools.h"
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_solver.h"
 #include "game_struct.h"
 #include "queue/queue.h"
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #define OPPOSITE_DIR(d) ((d + 2) % NB_DIRS)
+#define MAX_UNIQUE_ATTEMPTS 100
 
 // @copyright University of Bordeaux. All rights reserved, 2024.
 
@@ -20,7 +26,7 @@
  * the N-E-S-W directions (in that order). Thus, binary coding 1100 represents
  * the piece "└" (a corner in north orientation).
  */
-static uint _code[NB_SHAPES][NB_DIRS] = {
+const uint _code[NB_SHAPES][NB_DIRS] = {
     {0b0000, 0b0000, 0b0000, 0b0000}, // EMPTY {" ", " ", " ", " "}
     {0b1000, 0b0100, 0b0010, 0b0001}, // ENDPOINT {"^", ">", "v", "<"},
     {0b1010, 0b0101, 0b1010, 0b0101}, // SEGMENT {"|", "-", "|", "-"},
@@ -31,11 +37,6 @@ static uint _code[NB_SHAPES][NB_DIRS] = {
 
 /* ************************************************************************** */
 
-/** encode a shape and an orientation into an integer code */
-static uint _encode_shape(shape s, direction o) { return _code[s][o]; }
-
-/* ************************************************************************** */
-
 /** decode an integer code into a shape and an orientation */
 static bool _decode_shape(uint code, shape* s, direction* o) {
     assert(code >= 0 && code < 16);
@@ -53,171 +54,151 @@ static bool _decode_shape(uint code, shape* s, direction* o) {
 
 /* ************************************************************************** */
 
-/** add an half-edge in the direction d */
-static void _add_half_edge(game g, uint i, uint j, direction d) {
-    assert(g);
-    assert(i < game_nb_rows(g));
-    assert(j < game_nb_cols(g));
-    assert(d < NB_DIRS);
-
-    shape s = game_get_piece_shape(g, i, j);
-    direction o = game_get_piece_orientation(g, i, j);
-    uint code = _encode_shape(s, o);
-    uint mask = 0b1000 >> d;    // mask with half-edge in the direction d
-    assert((code & mask) == 0); // check there is no half-edge in the direction d
-    uint newcode = code | mask; // add the half-edge in the direction d
-    shape news;
-    direction newo;
-    bool ok = _decode_shape(newcode, &news, &newo);
-    assert(ok);
-    game_set_piece_shape(g, i, j, news);
-    game_set_piece_orientation(g, i, j, newo);
-}
+/** shape of a character of the text format, plus 1 (0 for an invalid character) */
+static const uint8_t _shape_of[256] = {['E'] = EMPTY + 1, ['N'] = ENDPOINT + 1, ['S'] = SEGMENT + 1,
+                                       ['C'] = CORNER + 1, ['T'] = TEE + 1, ['X'] = CROSS + 1};
 
-/* ************************************************************************** */
+/** direction of a character of the text format, plus 1 (0 for an invalid character) */
+static const uint8_t _dir_of[256] = {['N'] = NORTH + 1, ['E'] = EAST + 1, ['S'] = SOUTH + 1, ['W'] = WEST + 1};
 
-#define OPPOSITE_DIR(d) ((d + 2) % NB_DIRS)
-
-/* ************************************************************************** */
-
-/**
- * @brief Add an edge between two adjacent squares.
- * @details This is done by modifying the pieces of the two adjacent squares.
- * More precisely, we add an half-edge to each adjacent square, so as to build
- * an edge between these two squares.
- * @param g the game
- * @param i row index
- * @param j column index
- * @param d the direction of the adjacent square
- * @pre @p g must be a valid pointer toward a game structure.
- * @pre @p i < game height
- * @pre @p j < game width
- * @return true if an edge can be added, false otherwise
- */
-static bool _add_edge(game g, uint i, uint j, direction d) {
-    assert(g);
-    assert(i < game_nb_rows(g));
-    assert(j < game_nb_cols(g));
-    assert(d < NB_DIRS);
-
-    uint nexti, nextj;
-    bool next = game_get_ajacent_square(g, i, j, d, &nexti, &nextj);
-    if (!next)
-        return false;
+static const bool _is_space[256] = {[' '] = true, ['\t'] = true, ['\n'] = true, ['\v'] = true, ['\f'] = true, ['\r'] = true};
 
-    // check if the two half-edges are free
-    bool he = game_has_half_edge(g, i, j, d);
-    if (he)
-        return false;
-    bool next_he = game_has_half_edge(g, nexti, nextj, OPPOSITE_DIR(d));
-    if (next_he)
-        return false;
-
-    _add_half_edge(g, i, j, d);
-    _add_half_edge(g, nexti, nextj, OPPOSITE_DIR(d));
+static size_t _skip_spaces(const char* text, size_t len, size_t pos) {
+    while (pos < len && _is_space[(uint8_t)text[pos]]) pos++;
+    return pos;
+}
 
+static bool _parse_uint(const char* text, size_t len, size_t* pos, uint* x) {
+    size_t p = *pos;
+    uint64_t v = 0;
+    while (p < len && text[p] >= '0' && text[p] <= '9' && v <= UINT32_MAX) v = 10 * v + (text[p++] - '0');
+    if (p == *pos || v > UINT32_MAX) return false;
+    *x = v;
+    *pos = p;
     return true;
 }
 
-/* ************************************************************************** */
-
-game game_load(char* filename) {
-    assert(filename != NULL);
+/** fills the error with the line and column of a position (both from 1) */
+static game _parse_error(const char* text, size_t pos, const char* message, game_parse_error* error) {
+    if (error) {
+        error->line = 1;
+        error->col = 1;
+        for (size_t k = 0; k < pos; k++) {
+            if (text[k] == '\n') {
+                error->line++;
+                error->col = 1;
+            } else {
+                error->col++;
+            }
+        }
+        error->message = message;
+        error->pos = pos;
+    }
+    return NULL;
+}
 
-    // Ouvrir le fichier en lecture
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Erreur: Impossible d'ouvrir le fichier %s\n", filename);
+game game_parse(const char* text, size_t len, size_t* pos, game_parse_error* error) {
+    assert(text != NULL || len == 0);
+    assert(pos != NULL);
+
+    // dimensions et wrapping
+    size_t p = _skip_spaces(text, len, *pos);
+    uint nb_rows, nb_cols, wrapping;
+    if (!_parse_uint(text, len, &p, &nb_rows)) return _parse_error(text, p, "nombre de lignes attendu", error);
+    p = _skip_spaces(text, len, p);
+    if (!_parse_uint(text, len, &p, &nb_cols)) return _parse_error(text, p, "nombre de colonnes attendu", error);
+    p = _skip_spaces(text, len, p);
+    if (!_parse_uint(text, len, &p, &wrapping)) return _parse_error(text, p, "option wrapping attendue", error);
+    uint64_t size = (uint64_t)nb_rows * nb_cols;
+    if (size == 0 || size > UINT32_MAX) return _parse_error(text, *pos, "dimensions invalides", error);
+    // au moins deux caractères par case : ne pas allouer la grille d'un en-tête sans données
+    if ((len - p) / 2 < size) return _parse_error(text, len, "données manquantes", error);
+
+    // grille : une forme et une direction par case
+    shape* shapes = malloc(size * sizeof(shape));
+    direction* orientations = malloc(size * sizeof(direction));
+    if (!shapes || !orientations) {
+        fprintf(stderr, "Memory allocation error\n");
         exit(EXIT_FAILURE);
     }
+    const char* message = NULL;
+    for (uint sq = 0; sq < size && !message; sq++) {
+        p = _skip_spaces(text, len, p);
+        uint8_t s = p < len ? _shape_of[(uint8_t)text[p]] : 0;
+        if (!s) {
+            message = p < len ? "forme inconnue" : "données manquantes";
+            break;
+        }
+        p = _skip_spaces(text, len, p + 1);
+        uint8_t d = p < len ? _dir_of[(uint8_t)text[p]] : 0;
+        if (!d) {
+            message = p < len ? "direction inconnue" : "données manquantes";
+            break;
+        }
+        p++;
+        shapes[sq] = s - 1;
+        orientations[sq] = d - 1;
+    }
+    game g = message ? NULL : game_new_ext(nb_rows, nb_cols, shapes, orientations, wrapping);
+    free(shapes);
+    free(orientations);
+    if (!g) return _parse_error(text, p, message ? message : "jeu invalide", error);
+    *pos = p;
+    return g;
+}
 
-    // Lire les dimensions et wrapping
-    uint nb_rows, nb_cols;
-    int wrapping;
-    if (fscanf(file, "%u %u %d", &nb_rows, &nb_cols, &wrapping) != 3) {
-        fprintf(stderr, "Erreur: Format invalide dans le fichier %s\n", filename);
-        fclose(file);
+/** reads a whole stream in large blocks (with a final '\0') */
+static char* _read_all(FILE* file, size_t* len) {
+    size_t capacity = 1 << 16;
+    char* text = malloc(capacity);
+    size_t n = 0, r;
+    while (text && (r = fread(text + n, 1, capacity - 1 - n, file)) > 0) {
+        n += r;
+        if (n == capacity - 1) {
+            capacity *= 2;
+            char* bigger = realloc(text, capacity);
+            if (!bigger) free(text);
+            text = bigger;
+        }
+    }
+    if (!text) {
+        fprintf(stderr, "Memory allocation error\n");
         exit(EXIT_FAILURE);
     }
+    text[n] = '\0';
+    *len = n;
+    return text;
+}
 
-    // Créer le jeu vide
-    game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
-
-    // Lire la grille
-    for (uint i = 0; i < nb_rows; i++) {
-        for (uint j = 0; j < nb_cols; j++) {
-            char shape_char, dir_char;
-            if (fscanf(file, " %c %c", &shape_char, &dir_char) != 2) {
-                fprintf(stderr, "Erreur: Données manquantes ou incorrectes\n");
-                game_delete(g);
-                fclose(file);
-                exit(EXIT_FAILURE);
-            }
-
-            shape s;
-            direction d;
-
-            // Conversion des caractères en `shape`
-            switch (shape_char) {
-            case 'E':
-                s = EMPTY;
-                break;
-            case 'N':
-                s = ENDPOINT;
-                break;
-            case 'S':
-                s = SEGMENT;
-                break;
-            case 'C':
-                s = CORNER;
-                break;
-            case 'T':
-                s = TEE;
-                break;
-            case 'X':
-                s = CROSS;
-                break;
-            default:
-                fprintf(stderr, "Erreur: Shape inconnu '%c'\n", shape_char);
-                game_delete(g);
-                fclose(file);
-                exit(EXIT_FAILURE);
-            }
-
-            // Conversion des caractères en `direction`
-            switch (dir_char) {
-            case 'N':
-                d = NORTH;
-                break;
-            case 'E':
-                d = EAST;
-                break;
-            case 'S':
-                d = SOUTH;
-                break;
-            case 'W':
-                d = WEST;
-                break;
-            default:
-                fprintf(stderr, "Erreur: Direction inconnue '%c'\n", dir_char);
-                game_delete(g);
-                fclose(file);
-                exit(EXIT_FAILURE);
-            }
+game game_load(char* filename) {
+    assert(filename != NULL);
+    if (game_is_binary_filename(filename)) return game_load_binary(filename);
 
-            // Mettre à jour la pièce dans le jeu
-            game_set_piece_shape(g, i, j, s);
-            game_set_piece_orientation(g, i, j, d);
-        }
+    // Ouvrir le fichier en lecture ("-" pour l'entrée standard)
+    bool is_stdin = strcmp(filename, "-") == 0;
+    FILE* file = is_stdin ? stdin : fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Erreur: Impossible d'ouvrir le fichier %s\n", filename);
+        return NULL;
     }
-
-    fclose(file);
+    size_t len, pos = 0;
+    char* text = _read_all(file, &len);
+    if (!is_stdin) fclose(file);
+
+    game_parse_error error;
+    game g = game_parse(text, len, &pos, &error);
+    if (!g) fprintf(stderr, "Erreur: %s:%u:%u: %s\n", filename, error.line, error.col, error.message);
+    free(text);
     return g;
 }
 
 void game_save(cgame g, char* filename) {
     assert(g != NULL);
     assert(filename != NULL);
+    if (game_is_binary_filename(filename)) {
+        game_save_binary(g, filename);
+        return;
+    }
 
     // Ouvrir le fichier en écriture
     FILE* file = fopen(filename, "w");
@@ -225,6 +206,15 @@ void game_save(cgame g, char* filename) {
         fprintf(stderr, "Erreur: Impossible d'ouvrir le fichier %s pour sauvegarde\n", filename);
         exit(EXIT_FAILURE);
     }
+    game_write(g, file);
+
+    // Fermer le fichier après l'écriture
+    fclose(file);
+}
+
+void game_write(cgame g, FILE* file) {
+    assert(g != NULL);
+    assert(file != NULL);
 
     // Sauvegarder les dimensions du jeu et l'option de wrapping
     fprintf(file, "%u %u %d\n", game_nb_rows(g), game_nb_cols(g), game_is_wrapping(g));
@@ -232,8 +222,9 @@ void game_save(cgame g, char* filename) {
     // Sauvegarder la grille (formes et orientations)
     for (uint i = 0; i < game_nb_rows(g); i++) {
         for (uint j = 0; j < game_nb_cols(g); j++) {
-            shape s = game_get_piece_shape(g, i, j);
-            direction d = game_get_piece_orientation(g, i, j);
+            uint8_t cell = game_cell(g, i * game_nb_cols(g) + j);
+            shape s = game_cell_shape(cell);
+            direction d = game_cell_orientation(cell);
 
             char shape_char, dir_char;
 
@@ -259,7 +250,6 @@ void game_save(cgame g, char* filename) {
                 break;
             default:
                 fprintf(stderr, "Erreur: Shape invalide lors de la sauvegarde\n");
-                fclose(file);
                 exit(EXIT_FAILURE);
             }
 
@@ -279,7 +269,6 @@ void game_save(cgame g, char* filename) {
                 break;
             default:
                 fprintf(stderr, "Erreur: Direction invalide lors de la sauvegarde\n");
-                fclose(file);
                 exit(EXIT_FAILURE);
             }
 
@@ -288,12 +277,63 @@ void game_save(cgame g, char* filename) {
         }
         fprintf(file, "\n");
     }
+}
 
-    // Fermer le fichier après l'écriture
-    fclose(file);
+static double _now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
 }
 
-game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra) {
+/* ************************************************************************** */
+
+/** number of half-edges of a code */
+static uint _popcount4(uint8_t code) { return (code & 1) + ((code >> 1) & 1) + ((code >> 2) & 1) + ((code >> 3) & 1); }
+
+/**
+ * @brief Builds a uniform random spanning tree of the grid (Wilson's
+ * algorithm).
+ * @details Loop-erased random walks are run from each square until they hit
+ * the tree, and the walk (without its loops) is added to the tree.
+ * @param neighbors NB_DIRS adjacent squares per square (the square itself when
+ * there is no usable edge)
+ * @param size number of squares
+ * @param rng the random number generator
+ * @param codes half-edges of the tree at each square (output)
+ * @return false on memory allocation error
+ */
+static bool _random_spanning_tree(const uint* neighbors, uint size, game_rng* rng, uint8_t* codes) {
+    bool* in_tree = calloc(size, sizeof(bool));
+    uint8_t* next = malloc(size * sizeof(uint8_t));
+    if (!in_tree || !next) {
+        free(in_tree);
+        free(next);
+        return false;
+    }
+    memset(codes, 0, size * sizeof(uint8_t));
+    in_tree[game_rng_below(rng, size)] = true;
+    for (uint start = 0; start < size; start++) {
+        // random walk, only remembering the last exit of each square
+        for (uint u = start; !in_tree[u]; u = neighbors[u * NB_DIRS + next[u]]) {
+            direction dirs[NB_DIRS];
+            uint nb = 0;
+            for (direction d = NORTH; d < NB_DIRS; d++)
+                if (neighbors[u * NB_DIRS + d] != u) dirs[nb++] = d;
+            next[u] = dirs[game_rng_below(rng, nb)];
+        }
+        for (uint u = start; !in_tree[u]; u = neighbors[u * NB_DIRS + next[u]]) {
+            in_tree[u] = true;
+            uint v = neighbors[u * NB_DIRS + next[u]];
+            codes[u] |= 0b1000 >> next[u];
+            codes[v] |= 0b1000 >> OPPOSITE_DIR(next[u]);
+        }
+    }
+    free(in_tree);
+    free(next);
+    return true;
+}
+
+static void _random_check(uint nb_rows, uint nb_cols, uint nb_empty, uint nb_extra) {
     if (nb_empty > nb_rows * nb_cols) {
         fprintf(stderr, "Erreur: Trop de cases vides\n");
         exit(EXIT_FAILURE);
@@ -302,199 +342,439 @@ game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint
         fprintf(stderr, "Erreur: Il n'existe pas de solution avec 1 seul case non-vide\n");
         exit(EXIT_FAILURE);
     }
-    game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
-    if (nb_empty == nb_rows * nb_cols) {
-        return g;
+    if (nb_extra > (nb_cols - 1) * (nb_rows - 1)) {
+        fprintf(stderr, "Impoosible d'ajouter %u cycles, vérifiéz nb_extra\n", nb_extra);
+        exit(EXIT_FAILURE);
     }
+}
 
-    uint i = (((double)rand() * nb_rows) / RAND_MAX);
-    uint j = (((double)rand() * nb_cols) / RAND_MAX);
-    uint d = (((double)rand() * NB_DIRS) / RAND_MAX);
-
-    game_set_piece_shape(g, i, j, ENDPOINT);
-    uint i_adj, j_adj;
-    for (uint attempts = 0; attempts < NB_DIRS; attempts++) {
-        if (game_get_ajacent_square(g, i, j, d, &i_adj, &j_adj)) {
-            break;
-        }
-        d = (d + 1) % NB_DIRS;
-    }
-    game_set_piece_orientation(g, i, j, d);
-    game_set_piece_shape(g, i_adj, j_adj, ENDPOINT);
-    game_set_piece_orientation(g, i_adj, j_adj, OPPOSITE_DIR(d));
-    for (int k = 2; k < nb_rows * nb_cols - nb_empty; k++) {
-        bool found = false;
-        while (!found) {
-            i = rand() % nb_rows;
-            j = rand() % nb_cols;
-            if (game_get_piece_shape(g, i, j) != EMPTY) {
-                for (uint attempts = 0; attempts < NB_DIRS; attempts++) {
-                    d = (d + 1) % NB_DIRS;
-                    if (game_get_ajacent_square(g, i, j, d, &i_adj, &j_adj)) {
-                        if (game_get_piece_shape(g, i_adj, j_adj) == EMPTY) {
-                            found = true;
-                            break;
-                        }
-                    }
-                }
-            }
+/** adjacent squares of each square, the square itself standing for "no edge" (border, or edge looping back) */
+static uint* _random_neighbors(cgame g) {
+    uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g), size = nb_rows * nb_cols;
+    uint* neighbors = malloc(size * NB_DIRS * sizeof(uint));
+    if (!neighbors) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint sq = 0; sq < size; sq++) {
+        for (direction d = NORTH; d < NB_DIRS; d++) {
+            uint ni, nj;
+            bool next = game_get_ajacent_square(g, sq / nb_cols, sq % nb_cols, d, &ni, &nj);
+            neighbors[sq * NB_DIRS + d] = next ? ni * nb_cols + nj : sq;
         }
-        _add_edge(g, i, j, d);
     }
-    if (nb_extra > (nb_cols - 1) * (nb_rows - 1)) {
-        fprintf(stderr, "Impoosible d'ajouter %u cycles, vérifiéz nb_extra\n", nb_extra);
+    return neighbors;
+}
+
+/** random network: spanning tree, minus nb_empty leaves, plus nb_extra edges (if possible) */
+static void _random_codes(const uint* neighbors, uint size, uint nb_empty, uint nb_extra, game_rng* rng, uint8_t* codes) {
+    uint* leaves = malloc(size * sizeof(uint));
+    uint* candidates = malloc(2 * size * sizeof(uint));
+    if (!leaves || !candidates || !_random_spanning_tree(neighbors, size, rng, codes)) {
+        fprintf(stderr, "Memory allocation error\n");
         exit(EXIT_FAILURE);
     }
-    for (int l = 0; l < nb_extra; l++) {
-        bool found = false;
-        while (!found) {
-            i = rand() % nb_rows;
-            j = rand() % nb_cols;
-            if (game_get_piece_shape(g, i, j) != EMPTY) {
-                for (uint attempts = 0; attempts < NB_DIRS; attempts++) {
-                    d = (d + 1) % NB_DIRS;
-                    if (game_get_ajacent_square(g, i, j, d, &i_adj, &j_adj)) {
-                        if (game_check_edge(g, i, j, d) != MATCH) {
-                            found = true;
-                            break;
-                        }
-                    }
-                }
+
+    // remove random leaves until only the non-empty squares are left
+    uint nb_leaves = 0;
+    for (uint sq = 0; sq < size; sq++)
+        if (_popcount4(codes[sq]) == 1) leaves[nb_leaves++] = sq;
+    for (uint k = 0; k < nb_empty; k++) {
+        uint pick = game_rng_below(rng, nb_leaves);
+        uint leaf = leaves[pick];
+        leaves[pick] = leaves[--nb_leaves];
+        direction d = NORTH;
+        while (!(codes[leaf] & (0b1000 >> d))) d++;
+        uint v = neighbors[leaf * NB_DIRS + d];
+        codes[leaf] = 0;
+        codes[v] &= ~(0b1000 >> OPPOSITE_DIR(d));
+        if (_popcount4(codes[v]) == 1) leaves[nb_leaves++] = v;
+    }
+
+    // extra edges drawn from the list of all the missing edges between pieces
+    uint nb_candidates = 0;
+    for (uint sq = 0; sq < size; sq++) {
+        for (direction d = EAST; d <= SOUTH; d++) {
+            uint v = neighbors[sq * NB_DIRS + d];
+            if (v != sq && codes[sq] && codes[v] && !(codes[sq] & (0b1000 >> d)) &&
+                !(codes[v] & (0b1000 >> OPPOSITE_DIR(d)))) {
+                candidates[nb_candidates++] = sq * NB_DIRS + d;
             }
         }
-        _add_edge(g, i, j, d);
     }
+    for (uint k = 0; k < nb_extra && k < nb_candidates; k++) {
+        uint pick = k + game_rng_below(rng, nb_candidates - k);
+        uint edge = candidates[pick];
+        candidates[pick] = candidates[k];
+        uint sq = edge / NB_DIRS, v = neighbors[edge];
+        direction d = edge % NB_DIRS;
+        // with a width (or height) of 2, both edges between two squares may be drawn
+        if ((codes[sq] & (0b1000 >> d)) || (codes[v] & (0b1000 >> OPPOSITE_DIR(d)))) continue;
+        codes[sq] |= 0b1000 >> d;
+        codes[v] |= 0b1000 >> OPPOSITE_DIR(d);
+    }
+    free(leaves);
+    free(candidates);
+}
+
+static void _apply_codes(game g, const uint8_t* codes) {
+    uint nb_cols = game_nb_cols(g);
+    for (uint sq = 0; sq < game_nb_rows(g) * nb_cols; sq++) {
+        shape s;
+        direction o;
+        _decode_shape(codes[sq], &s, &o);
+        game_set_piece_shape(g, sq / nb_cols, sq % nb_cols, s);
+        game_set_piece_orientation(g, sq / nb_cols, sq % nb_cols, o);
+    }
+}
+
+/** default generator of the non-reentrant functions, seeded from rand() so that srand() still applies */
+static void _default_rng(game_rng* rng) { game_rng_seed(rng, rand()); }
+
+game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra) {
+    game_rng rng;
+    _default_rng(&rng);
+    return game_random_r(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, &rng);
+}
+
+game game_random_r(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, game_rng* rng) {
+    assert(rng);
+    _random_check(nb_rows, nb_cols, nb_empty, nb_extra);
+    game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
+    if (nb_empty == nb_rows * nb_cols) {
+        return g;
+    }
+    uint size = nb_rows * nb_cols;
+    uint* neighbors = _random_neighbors(g);
+    uint8_t* codes = malloc(size * sizeof(uint8_t));
+    if (!codes) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    _random_codes(neighbors, size, nb_empty, nb_extra, rng, codes);
+    _apply_codes(g, codes);
+    free(neighbors);
+    free(codes);
     return g;
 }
 
-void game_nb_solutions_aux(cgame g, uint index, uint* cpt) {
-    if (index >= game_nb_cols(g) * game_nb_rows(g)) {
-        if (game_won(g)) {
-            (*cpt)++;
+/* ************************************************************************** */
+
+/** network of the square a (squares marked with 1 in reached) */
+static void _reach(const uint8_t* codes, const uint* neighbors, uint size, uint a, uint8_t* reached, uint* stack) {
+    memset(reached, 0, size * sizeof(uint8_t));
+    uint top = 0;
+    stack[top++] = a;
+    reached[a] = 1;
+    while (top > 0) {
+        uint u = stack[--top];
+        for (direction d = NORTH; d < NB_DIRS; d++) {
+            uint v = neighbors[u * NB_DIRS + d];
+            if ((codes[u] & (0b1000 >> d)) && v != u && !reached[v]) {
+                reached[v] = 1;
+                stack[top++] = v;
+            }
         }
-        return;
     }
+}
 
-    uint x = index / game_nb_cols(g);
-    uint y = index % game_nb_cols(g);
+/**
+ * @brief Swaps an edge close to an ambiguous square for another one.
+ * @details An edge at distance at most 1 from @p u is removed. It is replaced
+ * by a missing edge between two pieces at distance at most 2 from @p u that
+ * keeps the network connected, so the number of pieces and of edges does not
+ * change, but the shapes around @p u do.
+ * @return false if no such swap was found
+ */
+static bool _swap_edge_near(uint8_t* codes, const uint* neighbors, uint size, uint u, game_rng* rng, uint8_t* reached,
+                            uint* stack) {
+    // squares close to u: u, then at distance 1, then at distance 2
+    uint near[1 + NB_DIRS + NB_DIRS * NB_DIRS];
+    uint nb_near = 0;
+    near[nb_near++] = u;
+    uint nb_close = 0;
+    for (uint k = 0; k < nb_close || k == 0; k++) {
+        for (direction d = NORTH; d < NB_DIRS; d++) {
+            uint v = neighbors[near[k] * NB_DIRS + d];
+            bool known = false;
+            for (uint l = 0; l < nb_near && !known; l++) known = near[l] == v;
+            if (!known) near[nb_near++] = v;
+        }
+        if (k == 0) nb_close = nb_near;
+    }
 
-    shape shape = game_get_piece_shape(g, x, y);
-    direction dir = game_get_piece_orientation(g, x, y);
+    // edge to remove, at distance at most 1
+    uint removable[(1 + NB_DIRS) * NB_DIRS];
+    uint nb_removable = 0;
+    for (uint k = 0; k < nb_close; k++)
+        for (direction d = NORTH; d < NB_DIRS; d++)
+            if (codes[near[k]] & (0b1000 >> d)) removable[nb_removable++] = near[k] * NB_DIRS + d;
+    if (nb_removable == 0) return false;
+    uint removed = removable[game_rng_below(rng, nb_removable)];
+    uint a = removed / NB_DIRS, b = neighbors[removed];
+    direction dr = removed % NB_DIRS;
+    codes[a] &= ~(0b1000 >> dr);
+    codes[b] &= ~(0b1000 >> OPPOSITE_DIR(dr));
+    _reach(codes, neighbors, size, a, reached, stack);
+    bool split = !reached[b];
+
+    // edge to add, at distance at most 2, reconnecting the network if needed
+    uint addable[(1 + NB_DIRS + NB_DIRS * NB_DIRS) * NB_DIRS];
+    uint nb_addable = 0;
+    for (uint k = 0; k < nb_near; k++) {
+        uint x = near[k];
+        for (direction d = NORTH; d < NB_DIRS; d++) {
+            uint y = neighbors[x * NB_DIRS + d];
+            bool pieces = (codes[x] || x == a || x == b) && (codes[y] || y == a || y == b);
+            if (y == x || !pieces) continue;
+            if ((codes[x] & (0b1000 >> d)) || (codes[y] & (0b1000 >> OPPOSITE_DIR(d)))) continue;
+            if ((x == a && d == dr) || (x == b && d == OPPOSITE_DIR(dr))) continue;
+            if (split && reached[x] == reached[y]) continue;
+            addable[nb_addable++] = x * NB_DIRS + d;
+        }
+    }
+    if (nb_addable == 0) {
+        codes[a] |= 0b1000 >> dr;
+        codes[b] |= 0b1000 >> OPPOSITE_DIR(dr);
+        return false;
+    }
+    uint added = addable[game_rng_below(rng, nb_addable)];
+    uint x = added / NB_DIRS, y = neighbors[added];
+    direction da = added % NB_DIRS;
+    codes[x] |= 0b1000 >> da;
+    codes[y] |= 0b1000 >> OPPOSITE_DIR(da);
+    return true;
+}
 
-    int rotations = 4;
+game game_random_unique(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra,
+                        game_random_stats* stats) {
+    game_rng rng;
+    _default_rng(&rng);
+    return game_random_unique_r(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, stats, &rng);
+}
 
-    if (shape == SEGMENT) {
-        rotations = 2;
-    } else if (shape == CROSS || shape == EMPTY) {
-        rotations = 1;
+game game_random_unique_r(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra,
+                          game_random_stats* stats, game_rng* rng) {
+    assert(rng);
+    _random_check(nb_rows, nb_cols, nb_empty, nb_extra);
+    double start = _now();
+    game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
+    uint size = nb_rows * nb_cols;
+    uint* neighbors = _random_neighbors(g);
+    uint8_t* codes = malloc(size * sizeof(uint8_t));
+    uint8_t* first = malloc(size * sizeof(uint8_t));
+    uint8_t* second = malloc(size * sizeof(uint8_t));
+    uint8_t* reached = malloc(size * sizeof(uint8_t));
+    uint* stack = malloc(size * sizeof(uint));
+    uint* ambiguous = malloc(size * sizeof(uint));
+    if (!codes || !first || !second || !reached || !stack || !ambiguous) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
     }
 
-    for (int i = 0; i < rotations; i++) {
-        game_set_piece_orientation((game)g, x, y, (dir + i) % 4);
-        if (!game_is_wrapping(g)) {
-            if (game_check_edge(g, x, y, NORTH) == MISMATCH || (game_check_edge(g, x, y, WEST)) == MISMATCH) {
-                continue;
-            }
-        } else {
-            if (x == game_nb_rows(g) - 1) {
-                if (game_check_edge(g, x, y, SOUTH) == MISMATCH) {
-                    continue;
-                }
-            }
-            if (y == game_nb_cols(g) - 1) {
-                if (game_check_edge(g, x, y, EAST) == MISMATCH) {
-                    continue;
-                }
-            }
-            if (x == 0 && y != 0) {
-                if (game_check_edge(g, x, y, WEST) == MISMATCH) {
-                    continue;
-                }
-            }
-            if (x != 0 && y == 0) {
-                if (game_check_edge(g, x, y, NORTH) == MISMATCH) {
-                    continue;
-                }
+    game_random_stats st = {0, 0, 0};
+    bool unique = nb_empty == size;
+    while (!unique && st.nb_attempts < MAX_UNIQUE_ATTEMPTS) {
+        st.nb_attempts++;
+        _random_codes(neighbors, size, nb_empty, nb_extra, rng, codes);
+        for (uint fix = 0; fix <= size && !unique; fix++) {
+            _apply_codes(g, codes);
+            solver* s = solver_new(g);
+            if (!s) {
+                fprintf(stderr, "Memory allocation error\n");
+                exit(EXIT_FAILURE);
             }
-            if (x != 0 && y != 0) {
-                if (game_check_edge(g, x, y, NORTH) == MISMATCH || (game_check_edge(g, x, y, WEST)) == MISMATCH) {
-                    continue;
-                }
+            solver_solve(s);
+            solver_get_solution(s, first);
+            // the search finds the solutions in the same order: the second one is new
+            unique = solver_count_limit(s, 2) == 1;
+            if (!unique) solver_get_solution(s, second);
+            solver_delete(s);
+            if (unique) break;
+
+            // fix the network around a square where the two solutions differ
+            uint nb_ambiguous = 0;
+            for (uint sq = 0; sq < size; sq++) {
+                shape sh = _game_shape(g, sq);
+                if (_code[sh][first[sq]] != _code[sh][second[sq]]) ambiguous[nb_ambiguous++] = sq;
             }
+            uint u = ambiguous[game_rng_below(rng, nb_ambiguous)];
+            if (_swap_edge_near(codes, neighbors, size, u, rng, reached, stack)) st.nb_fixes++;
         }
-        game_nb_solutions_aux(g, index + 1, cpt);
     }
-    game_set_piece_orientation((game)g, x, y, dir);
+
+    free(neighbors);
+    free(codes);
+    free(first);
+    free(second);
+    free(reached);
+    free(stack);
+    free(ambiguous);
+    st.time = _now() - start;
+    if (stats) *stats = st;
+    if (!unique) {
+        game_delete(g);
+        return NULL;
+    }
+    return g;
+}
+
+uint game_nb_solutions(cgame g) { return game_nb_solutions_stats(g, NULL); }
+
+bool game_solve(game g) { return game_solve_stats(g, NULL); }
+
+/* ************************************************************************** */
+
+static solver* _stats_solver(cgame g, game_stats* stats) {
+    solver* s = solver_new(g);
+    if (!s) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    if (stats) {
+        memset(stats, 0, sizeof(game_stats));
+        solver_set_stats(s, stats);
+    }
+    return s;
 }
 
-uint game_nb_solutions(cgame g) {
-    uint cpt = 0;
-    game_nb_solutions_aux(g, 0, &cpt);
-    return cpt;
+bool game_solve_stats(game g, game_stats* stats) {
+    double start = _now();
+    solver* s = _stats_solver(g, stats);
+    bool found = solver_solve(s);
+    if (found) {
+        solver_apply(s, g);
+    }
+    solver_delete(s);
+    if (stats) stats->time = _now() - start;
+    return found;
 }
 
-bool game_solve_aux(game g, uint index) {
-    if (index >= game_nb_cols(g) * game_nb_rows(g)) {
-        if (game_won(g)) {
-            game_print(g);
-            return true;
-        }
-        return false;
+/** @brief Stop condition of game_solve_until. */
+typedef struct {
+    bool (*cancel)(void* data);
+    void* data;
+    double deadline; // 0 for none
+    bool cancelled;
+} solve_limits;
+
+static bool _limits_reached(void* data) {
+    solve_limits* l = data;
+    if (l->cancel && l->cancel(l->data)) l->cancelled = true;
+    return l->cancelled || (l->deadline > 0 && _now() >= l->deadline);
+}
+
+solve_status game_solve_until(game g, bool (*cancel)(void* data), void* data, double time_limit) {
+    solve_limits limits = {cancel, data, time_limit > 0 ? _now() + time_limit : 0, false};
+    solver* s = _stats_solver(g, NULL);
+    solver_set_stop(s, _limits_reached, &limits);
+    solve_status status = SOLVE_NONE;
+    if (solver_solve(s)) {
+        solver_apply(s, g);
+        status = SOLVE_FOUND;
+    } else if (solver_stopped(s)) {
+        status = limits.cancelled ? SOLVE_CANCELLED : SOLVE_TIMEOUT;
     }
+    solver_delete(s);
+    return status;
+}
+
+uint64_t game_nb_solutions_stats(cgame g, game_stats* stats) {
+    double start = _now();
+    solver* s = _stats_solver(g, stats);
+    uint64_t nb = solver_count(s);
+    solver_delete(s);
+    if (stats) stats->time = _now() - start;
+    return nb;
+}
 
-    uint x = index / game_nb_cols(g);
-    uint y = index % game_nb_cols(g);
+/* ************************************************************************** */
+
+bool game_rate(cgame g, game_rating* rating) {
+    assert(g && rating);
+    solver* s = solver_new(g);
+    if (!s) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    game_stats stats;
+    memset(&stats, 0, sizeof(game_stats));
+    memset(rating, 0, sizeof(game_rating));
+    bool found = solver_deduce(s, &rating->nb_open, &rating->nb_forced);
+    if (found) {
+        solver_set_stats(s, &stats);
+        found = solver_solve(s);
+    }
+    solver_delete(s);
+
+    // every node but the root comes from a decision
+    rating->nb_decisions = stats.nb_nodes > 0 ? stats.nb_nodes - 1 : 0;
+    for (uint d = 1; d < GAME_STATS_MAX_DEPTH; d++)
+        if (stats.nb_backtracks[d] > 0) rating->max_backtrack = d;
+    if (rating->nb_decisions == 0) rating->tier = DIFFICULTY_EASY;
+    else if (rating->max_backtrack <= RATE_SHALLOW_DEPTH) rating->tier = DIFFICULTY_MEDIUM;
+    else rating->tier = DIFFICULTY_HARD;
+    return found;
+}
 
-    shape shape = game_get_piece_shape(g, x, y);
-    direction dir = game_get_piece_orientation(g, x, y);
+const char* game_difficulty_name(difficulty tier) {
+    static const char* names[NB_DIFFICULTIES] = {"easy", "medium", "hard"};
+    return tier < NB_DIFFICULTIES ? names[tier] : "unknown";
+}
 
-    int rotations = 4;
+/* ************************************************************************** */
 
-    if (shape == SEGMENT) {
-        rotations = 2;
-    } else if (shape == CROSS || shape == EMPTY) {
-        rotations = 1;
+static const char* _prune_names[NB_PRUNE_REASONS] = {"edge", "border", "connectivity"};
+
+/** writes s as a JSON string, escaping quotes, backslashes and control characters */
+static void _json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (const unsigned char* c = (const unsigned char*)s; *c; c++) {
+        switch (*c) {
+            case '"': fputs("\\\"", f); break;
+            case '\\': fputs("\\\\", f); break;
+            case '\b': fputs("\\b", f); break;
+            case '\f': fputs("\\f", f); break;
+            case '\n': fputs("\\n", f); break;
+            case '\r': fputs("\\r", f); break;
+            case '\t': fputs("\\t", f); break;
+            default:
+                if (*c < 0x20)
+                    fprintf(f, "\\u%04x", *c);
+                else
+                    fputc(*c, f);
+        }
     }
+    fputc('"', f);
+}
 
-    for (int i = 0; i < rotations; i++) {
-        game_set_piece_orientation(g, x, y, (dir + i) % rotations);
-        if (!game_is_wrapping(g)) {
-            if (game_check_edge(g, x, y, NORTH) == MISMATCH || (game_check_edge(g, x, y, WEST)) == MISMATCH) {
-                continue;
-            }
-        } else {
-            if (x == game_nb_rows(g) - 1) {
-                if (game_check_edge(g, x, y, SOUTH) == MISMATCH) {
-                    continue;
-                }
-            }
-            if (y == game_nb_cols(g) - 1) {
-                if (game_check_edge(g, x, y, EAST) == MISMATCH) {
-                    continue;
-                }
-            }
-            if (x == 0 && y != 0) {
-                if (game_check_edge(g, x, y, WEST) == MISMATCH) {
-                    continue;
-                }
-            }
-            if (x != 0 && y == 0) {
-                if (game_check_edge(g, x, y, NORTH) == MISMATCH) {
-                    continue;
-                }
-            }
-            if (x != 0 && y != 0) {
-                if (game_check_edge(g, x, y, NORTH) == MISMATCH || (game_check_edge(g, x, y, WEST)) == MISMATCH) {
-                    continue;
-                }
-            }
+void game_stats_print(FILE* f, const char* name, const game_stats* stats, bool json) {
+    assert(f && stats);
+    uint last = stats->max_depth < GAME_STATS_MAX_DEPTH ? stats->max_depth : GAME_STATS_MAX_DEPTH - 1;
+    double rate = stats->time > 0 ? stats->nb_nodes / stats->time : 0;
+    if (json) {
+        fprintf(f, "{");
+        if (name) {
+            fprintf(f, "\"name\":");
+            _json_string(f, name);
+            fprintf(f, ",");
         }
-        if (game_solve_aux(g, index + 1)) {
-            return true;
+        fprintf(f, "\"nodes\":%" PRIu64 ",\"prunes\":{", stats->nb_nodes);
+        for (uint r = 0; r < NB_PRUNE_REASONS; r++) {
+            fprintf(f, "%s\"%s\":%" PRIu64, r ? "," : "", _prune_names[r], stats->nb_prunes[r]);
         }
+        fprintf(f, "},\"max_depth\":%u,\"backtracks\":[", stats->max_depth);
+        for (uint d = 0; d <= last; d++) fprintf(f, "%s%" PRIu64, d ? "," : "", stats->nb_backtracks[d]);
+        fprintf(f, "],\"time\":%.6f}\n", stats->time);
+        return;
     }
-    game_set_piece_orientation(g, x, y, dir);
-    return false;
+    if (name) fprintf(f, "%s:\n", name);
+    fprintf(f, "  nodes: %" PRIu64 " (%.0f nodes/s)\n", stats->nb_nodes, rate);
+    for (uint r = 0; r < NB_PRUNE_REASONS; r++) {
+        fprintf(f, "  %s prunes: %" PRIu64 "\n", _prune_names[r], stats->nb_prunes[r]);
+    }
+    fprintf(f, "  max depth: %u\n", stats->max_depth);
+    fprintf(f, "  backtracks per depth:");
+    for (uint d = 0; d <= last; d++) fprintf(f, " %" PRIu64, stats->nb_backtracks[d]);
+    fprintf(f, "\n  time: %.6f s\n", stats->time);
 }
-
-bool game_solve(game g) { return game_solve_aux(g, 0); }
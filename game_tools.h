@@ -9,32 +9,180 @@
 #ifndef __GAME_TOOLS_H__
 #define __GAME_TOOLS_H__
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "game.h"
 #include "game_ext.h"
+#include "game_rng.h"
 
 /**
  * @name Game Tools
  * @{
  */
 
+/**
+ * @brief Position and reason of a syntax error, see @ref game_parse.
+ */
+typedef struct {
+    uint line;           /**< line of the error (from 1) */
+    uint col;            /**< column of the error (from 1) */
+    const char* message; /**< static description of the error */
+    size_t pos;          /**< offset of the error in the buffer */
+} game_parse_error;
+
 /**
  * @brief Creates a game by loading its description from a text file.
- * @details See details in the file format description.
- * @param filename input file
- * @return the loaded game
+ * @details See details in the file format description. The whole file is read
+ * at once and parsed with @ref game_parse. A file name ending with
+ * @ref GAME_BINARY_EXT is loaded with game_load_binary instead.
+ * @param filename input file, or "-" for the standard input
+ * @return the loaded game, or NULL if the file cannot be read or is invalid
+ * (the error is printed on stderr with its line and column)
  **/
 game game_load(char* filename);
 
+/**
+ * @brief Parses a game in the text format from a memory buffer.
+ * @details Parsing starts at offset @p *pos, so that several games written one
+ * after the other can be read from the same buffer.
+ * @param text the buffer
+ * @param len length of the buffer
+ * @param pos offset of the game in the buffer, moved after it on success
+ * @param error if not NULL, filled in on failure (the line and column count
+ * from the start of the buffer)
+ * @return the parsed game, or NULL on a syntax error
+ **/
+game game_parse(const char* text, size_t len, size_t* pos, game_parse_error* error);
+
 /**
  * @brief Saves a game in a text file.
- * @details See details the file format description.
+ * @details See details the file format description. A file name ending with
+ * @ref GAME_BINARY_EXT is saved with game_save_binary instead.
  * @param g game to save
  * @param filename output file
  **/
 void game_save(cgame g, char* filename);
 
+/**
+ * @brief Writes a game in the text format to an open stream.
+ * @details Same format as game_save, so that several games can be written one
+ * after the other in the same file.
+ * @param g game to write
+ * @param file output stream
+ **/
+void game_write(cgame g, FILE* file);
+
+/**
+ * @brief Extension of the binary game files.
+ * @details game_load and game_save use the binary format for file names with
+ * this extension, and the text format otherwise.
+ */
+#define GAME_BINARY_EXT ".netb"
+
+/**
+ * @brief Loads a game from a binary file.
+ * @details The file holds a 16-byte header (magic "NETB", version, wrapping
+ * flag, numbers of rows and columns) followed by one byte per square. It is
+ * memory-mapped and the game is built straight from the mapped bytes.
+ * @param filename input file
+ * @return the loaded game, or NULL if the file cannot be read or is invalid
+ **/
+game game_load_binary(const char* filename);
+
+/**
+ * @brief Saves a game in a binary file (see game_load_binary).
+ * @param g game to save
+ * @param filename output file
+ **/
+void game_save_binary(cgame g, const char* filename);
+
+/**
+ * @brief Tells if a file name has the binary extension @ref GAME_BINARY_EXT.
+ * @param filename the file name
+ * @return true for a binary file name
+ **/
+bool game_is_binary_filename(const char* filename);
+
+/**
+ * @brief Extension of the archive files, see @ref game_archive.
+ */
+#define GAME_ARCHIVE_EXT ".neta"
+
+/**
+ * @brief Tells if a file name has the archive extension @ref GAME_ARCHIVE_EXT.
+ * @param filename the file name
+ * @return true for an archive file name
+ **/
+bool game_is_archive_filename(const char* filename);
+
+/**
+ * @brief Archive of many games in a single file.
+ * @details The games are stored one after the other in the binary format (see
+ * game_load_binary), followed by an index of their offsets. A mapped archive
+ * gives any game in constant time, and an archive can also be read in order
+ * from a stream (a pipe or the standard input), without its index.
+ */
+typedef struct game_archive_s* game_archive;
+
+/**
+ * @brief Opens an archive.
+ * @details For reading, the file is memory-mapped when possible, otherwise it
+ * is read as a stream and only game_archive_next is available. For writing,
+ * the games are appended to the existing archive, or to a new one.
+ * @param filename the archive, or "-" for the standard input or output
+ * @param write true to append games, false to read them
+ * @return the archive, or NULL on error (printed on stderr)
+ **/
+game_archive game_archive_open(const char* filename, bool write);
+
+/**
+ * @brief Number of games of an archive.
+ * @param a the archive
+ * @return the number of games (for a stream, the number of games read so far)
+ **/
+uint64_t game_archive_nb_games(game_archive a);
+
+/**
+ * @brief Gets a game of an archive opened for reading.
+ * @param a the archive
+ * @param k index of the game, from 0
+ * @return a new game, or NULL if @p k is out of range, the archive is a
+ * stream, or the game is invalid
+ **/
+game game_archive_get(game_archive a, uint64_t k);
+
+/**
+ * @brief Gets the next game of an archive opened for reading, in order.
+ * @details An invalid or truncated game also stops the reading: see
+ * @ref game_archive_error to tell it from the end of the archive.
+ * @param a the archive
+ * @return a new game, or NULL at the end of the archive or on an invalid game
+ **/
+game game_archive_next(game_archive a);
+
+/**
+ * @brief Tells whether game_archive_next stopped on an invalid game.
+ * @param a the archive
+ * @return true if a game read in order was invalid or truncated
+ **/
+bool game_archive_error(game_archive a);
+
+/**
+ * @brief Appends a game to an archive opened for writing.
+ * @param a the archive
+ * @param g the game
+ * @return false on a write error
+ **/
+bool game_archive_append(game_archive a, cgame g);
+
+/**
+ * @brief Closes an archive, writing its index if it was opened for writing.
+ * @param a the archive (may be NULL)
+ * @return false on a write error
+ **/
+bool game_archive_close(game_archive a);
+
 /**
  * @brief Creates a random game solution with a given size and options.
  * @param nb_rows number of rows in game
@@ -45,10 +193,55 @@ void game_save(cgame g, char* filename);
  * @pre nb_cols * nb_rows >= 2
  * @pre nb_empty <= (nb_cols * nb_rows - 2)
  * @pre nb_extra must be small enough compared to the number of non-empty squares
+ * @details Uses a generator seeded from rand(), see game_random_r.
  * @return the generated random game (or NULL in case of error)
  */
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra);
 
+/**
+ * @brief Creates a random game solution with a given generator.
+ * @details Reentrant version of game_random: the result only depends on the
+ * state of @p rng, which is advanced.
+ * @param rng the random number generator
+ * @pre same as game_random
+ * @return the generated random game
+ */
+game game_random_r(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, game_rng* rng);
+
+/** @brief Work done by game_random_unique. */
+typedef struct {
+    uint nb_attempts; /**< number of random networks generated */
+    uint nb_fixes;    /**< number of edges moved to remove ambiguities */
+    double time;      /**< elapsed time, in seconds */
+} game_random_stats;
+
+/**
+ * @brief Creates a random game solution whose puzzle has a single solution.
+ * @details A random network is generated as in game_random, then solved while
+ * looking for a second solution (the count stops at 2). As long as one is
+ * found, an edge is moved next to a square where both solutions differ,
+ * keeping the network connected and the same number of edges and pieces. A new
+ * network is generated when this does not converge.
+ * @param nb_rows number of rows in game
+ * @param nb_cols number of columns in game
+ * @param wrapping wrapping option
+ * @param nb_empty number of empty squares
+ * @param nb_extra number of extra edges, that make cycles (if possible)
+ * @param stats if not NULL, filled with the work done
+ * @pre same as game_random
+ * @return the generated game, or NULL if no unique puzzle has been found
+ */
+game game_random_unique(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, game_random_stats* stats);
+
+/**
+ * @brief Reentrant version of game_random_unique, with a given generator.
+ * @param rng the random number generator
+ * @pre same as game_random_unique
+ * @return the generated game, or NULL if no unique puzzle has been found
+ */
+game game_random_unique_r(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, game_random_stats* stats,
+                          game_rng* rng);
+
 /**
  * @}
  */
@@ -62,6 +255,50 @@ game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint
  */
 bool game_solve(game g);
 
+/**
+ * @brief Outcomes of @ref game_solve_until.
+ */
+typedef enum {
+    SOLVE_FOUND,     /**< the game has been solved */
+    SOLVE_NONE,      /**< the game has no solution */
+    SOLVE_CANCELLED, /**< the search has been cancelled */
+    SOLVE_TIMEOUT,   /**< the time limit has been reached */
+} solve_status;
+
+/**
+ * @brief Computes the solution of a given game, unless it is cancelled or
+ * takes too long.
+ * @param g the game to solve
+ * @param cancel a function polled during the search (see solver_set_stop),
+ * which returns true to cancel it (or NULL)
+ * @param data the argument given to @p cancel
+ * @param time_limit maximum wall-clock time of the search in seconds (0 for no
+ * limit)
+ * @details The game @p g is updated with the first solution found. Otherwise,
+ * @p g is unchanged. Since the search only polls @p cancel and the clock, it
+ * can run on a worker thread over a copy of the game. @p cancel is called by
+ * the thread running the search: a flag set by another thread must then be
+ * written and read atomically (e.g. with SDL_AtomicSet and SDL_AtomicGet), a
+ * plain or volatile variable is a data race.
+ * @return the outcome of the search
+ */
+solve_status game_solve_until(game g, bool (*cancel)(void* data), void* data, double time_limit);
+
+/**
+ * @brief Computes the solution of a given game with the SAT backend.
+ * @param g the game to solve
+ * @details The orientations of the squares and the edges of the grid are
+ * encoded as boolean variables constrained so that the half-edges agree, and
+ * solved by a built-in clause-learning SAT solver. Connectivity is checked on
+ * each model found, and each network of a disconnected model is cut off by a
+ * new clause before searching again. This backend is meant for large wrapping
+ * games, where the search of @ref game_solve has no border to start from.
+ * The game @p g is updated with the first solution found. If there are no
+ * solution for this game, @p g must be unchanged.
+ * @return true if a solution is found, false otherwise
+ */
+bool game_solve_sat(game g);
+
 /**
  * @brief Computes the total number of solutions of a given game.
  * @param g the game
@@ -73,6 +310,140 @@ bool game_solve(game g);
 
 uint game_nb_solutions(cgame g);
 
+/**
+ * @brief Computes the total number of solutions of a given game with several
+ * threads.
+ * @param g the game
+ * @param nb_threads number of worker threads (0 to use one thread per
+ * processor)
+ * @details The search tree is split at a shallow depth into independent
+ * subtrees, each worker counts them on its own copy of the grid and idle
+ * workers steal subtrees from the others.
+ * @post The game @p g must be unchanged.
+ * @return the number of solutions (on 64 bits, unlike @ref game_nb_solutions)
+ */
+uint64_t game_nb_solutions_parallel(cgame g, uint nb_threads);
+
+/**
+ * @brief Computes the total number of solutions of a given game with a
+ * frontier dynamic programming.
+ * @param g the game
+ * @param[out] nb_solutions the number of solutions (output)
+ * @details The grid is swept square by square along its smallest dimension,
+ * only keeping the dangling half-edges between the placed squares and the
+ * others, together with the network each of them belongs to. Identical
+ * frontiers are merged, so the running time is linear in the number of squares
+ * and exponential only in the width of the grid. Solutions are counted as in
+ * @ref game_nb_solutions.
+ * @post The game @p g must be unchanged.
+ * @return false if the game is wrapping, if both its dimensions are greater
+ * than 14, or if the number of solutions does not fit on 64 bits; true
+ * otherwise
+ */
+bool game_nb_solutions_frontier(cgame g, uint64_t* nb_solutions);
+
+/**
+ * @brief Number of search levels whose backtracks are counted separately in
+ * @ref game_stats (the last one gathers all the deeper levels).
+ */
+#define GAME_STATS_MAX_DEPTH 64
+
+/**
+ * @brief Reasons why the search abandons a node.
+ */
+typedef enum {
+    PRUNE_EDGE,         /**< a square disagrees with all its neighbours */
+    PRUNE_BORDER,       /**< a square only fits beyond the border of the grid
+                           (or wrapping back onto itself) */
+    PRUNE_CONNECTIVITY, /**< the pieces can no longer form a single network */
+    NB_PRUNE_REASONS,
+} prune_reason;
+
+/**
+ * @brief Statistics of a search, filled in by @ref game_solve_stats and
+ * @ref game_nb_solutions_stats.
+ */
+typedef struct {
+    uint64_t nb_nodes;                             /**< nodes visited */
+    uint64_t nb_prunes[NB_PRUNE_REASONS];          /**< dead ends per reason */
+    uint max_depth;                                /**< deepest branching level */
+    uint64_t nb_backtracks[GAME_STATS_MAX_DEPTH];  /**< dead ends per level */
+    double time;                                   /**< wall-clock time (s) */
+} game_stats;
+
+/**
+ * @brief Same as @ref game_solve, also filling in search statistics.
+ * @param g the game to solve
+ * @param[out] stats the statistics of the search (output)
+ * @return true if a solution is found, false otherwise
+ */
+bool game_solve_stats(game g, game_stats* stats);
+
+/**
+ * @brief Same as @ref game_nb_solutions, also filling in search statistics.
+ * @param g the game
+ * @param[out] stats the statistics of the search (output)
+ * @return the number of solutions (on 64 bits, unlike @ref game_nb_solutions)
+ */
+uint64_t game_nb_solutions_stats(cgame g, game_stats* stats);
+
+/**
+ * @brief Prints search statistics.
+ * @param f the output stream
+ * @param name a name for this search, e.g. the game file (or NULL)
+ * @param stats the statistics
+ * @param json if true, prints a single JSON object on one line (JSON lines
+ * format), otherwise a human-readable report
+ */
+void game_stats_print(FILE* f, const char* name, const game_stats* stats, bool json);
+
+/**
+ * @brief Difficulty tiers of a puzzle, see @ref game_rate.
+ */
+typedef enum {
+    DIFFICULTY_EASY,   /**< solved by local deduction, without any branching */
+    DIFFICULTY_MEDIUM, /**< branching, but dead ends are found at shallow depths */
+    DIFFICULTY_HARD,   /**< deep backtracks */
+    NB_DIFFICULTIES,
+} difficulty;
+
+/**
+ * @brief Depth beyond which a backtrack makes a puzzle hard.
+ */
+#define RATE_SHALLOW_DEPTH 3
+
+/**
+ * @brief Rating of a puzzle, filled in by @ref game_rate.
+ */
+typedef struct {
+    uint nb_open;          /**< pieces with several distinct orientations */
+    uint nb_forced;        /**< pieces oriented by local deduction alone */
+    uint64_t nb_decisions; /**< branching decisions of the search */
+    uint max_backtrack;    /**< deepest branching level of a dead end (0 if none) */
+    difficulty tier;       /**< difficulty tier */
+} game_rating;
+
+/**
+ * @brief Rates the difficulty of a puzzle.
+ * @details A single deterministic pass of the search engine: the constraints
+ * are first propagated without branching, then the first solution is searched.
+ * The puzzle is easy if the search needs no decision, hard if a dead end is
+ * found deeper than @ref RATE_SHALLOW_DEPTH branching levels, and medium
+ * otherwise.
+ * @param g the game
+ * @param rating the rating (output)
+ * @post The game @p g must be unchanged.
+ * @return false if the game has no solution (the rating is then meaningless)
+ */
+bool game_rate(cgame g, game_rating* rating);
+
+/**
+ * @brief Name of a difficulty tier ("easy", "medium" or "hard").
+ * @param tier the tier
+ * @return a static string
+ */
+const char* game_difficulty_name(difficulty tier);
+
 /**
  * @
  */
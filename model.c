@@ -1,6 +1,7 @@
 #include "model.h"
 #include "game.h"
 #include "game_aux.h"
+#include "game_ext.h"
 #include "game_tools.h"
 #include <SDL.h>
 #include <SDL_image.h>
@@ -9,6 +10,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define SOLVE_TIME_LIMIT 30.0  // seconds before the background solve gives up
+#define MESSAGE_DELAY 2000     // milliseconds a status message stays on screen
+#define SPINNER_DOTS 8
+#define HISTORY_MAX_BYTES (64 * 1024) // bound of the undo history of long sessions
+
 /* **************************************************************** */
 
 struct Env_t {
@@ -28,6 +34,16 @@ struct Env_t {
     SDL_Rect undo_btn;
     SDL_Rect redo_btn;
     SDL_Rect solve_btn;  // New button
+
+    // Background solve (on a copy of the game)
+    SDL_Thread* solve_thread;
+    game solve_game;
+    SDL_atomic_t solve_cancel;
+    SDL_atomic_t solve_done;
+    solve_status solve_result;
+
+    const char* message;  // status message (or NULL)
+    Uint32 message_end;
 };
 
 /* **************************************************************** */
@@ -52,11 +68,102 @@ void renderText(SDL_Renderer* ren, TTF_Font* font, const char* text, SDL_Color c
 
 /* **************************************************************** */
 
+/* Polled by the solver thread: the flag is set by the UI thread */
+static bool solveCancelled(void* data) { return SDL_AtomicGet(&((Env*)data)->solve_cancel) != 0; }
+
+static int solveThread(void* data) {
+    Env* env = data;
+    env->solve_result = game_solve_until(env->solve_game, solveCancelled, env, SOLVE_TIME_LIMIT);
+    SDL_AtomicSet(&env->solve_done, 1);
+    return 0;
+}
+
+static bool isSolving(Env* env) { return env->solve_thread != NULL; }
+
+static void showMessage(Env* env, const char* message) {
+    env->message = message;
+    env->message_end = SDL_GetTicks() + MESSAGE_DELAY;
+}
+
+/* Starts solving a copy of the game on a worker thread, so that the window keeps responding */
+static void startSolve(Env* env) {
+    if (isSolving(env)) return;
+    env->solve_game = game_copy(env->g);
+    SDL_AtomicSet(&env->solve_cancel, 0);
+    SDL_AtomicSet(&env->solve_done, 0);
+    env->solve_thread = SDL_CreateThread(solveThread, "solver", env);
+    if (!env->solve_thread) {
+        PRINT("Warning: unable to create the solver thread (%s)\n", SDL_GetError());
+        game_delete(env->solve_game);
+        env->solve_game = NULL;
+    }
+}
+
+/* Waits for the worker thread, then applies the solution in one go */
+static void finishSolve(Env* env) {
+    SDL_WaitThread(env->solve_thread, NULL);
+    env->solve_thread = NULL;
+    if (env->solve_result == SOLVE_FOUND) {
+        for (uint i = 0; i < game_nb_rows(env->g); i++) {
+            for (uint j = 0; j < game_nb_cols(env->g); j++) {
+                direction d = game_get_piece_orientation(env->solve_game, i, j);
+                if (game_get_piece_orientation(env->g, i, j) != d) game_set_piece_orientation(env->g, i, j, d);
+            }
+        }
+    } else if (env->solve_result == SOLVE_NONE) {
+        showMessage(env, "No solution");
+    } else if (env->solve_result == SOLVE_TIMEOUT) {
+        showMessage(env, "Too long, gave up");
+    } else {
+        showMessage(env, "Cancelled");
+    }
+    game_delete(env->solve_game);
+    env->solve_game = NULL;
+}
+
+static void cancelSolve(Env* env) {
+    if (isSolving(env)) SDL_AtomicSet(&env->solve_cancel, 1);
+}
+
+/* Applies the result of the background solve once it is available */
+static void pollSolve(Env* env) {
+    if (isSolving(env) && SDL_AtomicGet(&env->solve_done)) finishSolve(env);
+}
+
+/* **************************************************************** */
+
+static void renderSpinner(SDL_Renderer* ren, Env* env) {
+    SDL_Rect msg_bg = {env->window_width/2 - 140, env->button_area_height + env->margin, 280, 40};
+    SDL_SetRenderDrawColor(ren, 255, 255, 255, 230);
+    SDL_RenderFillRect(ren, &msg_bg);
+
+    // dots around a circle, the highlighted one turns with time
+    int cx = msg_bg.x + 20, cy = msg_bg.y + msg_bg.h/2, radius = 10;
+    int current = (SDL_GetTicks() / DELAY) % SPINNER_DOTS;
+    static const int dx[SPINNER_DOTS] = {0, 7, 10, 7, 0, -7, -10, -7};
+    static const int dy[SPINNER_DOTS] = {-10, -7, 0, 7, 10, 7, 0, -7};
+    for (int k = 0; k < SPINNER_DOTS; k++) {
+        int shade = (k == current) ? 0 : 180;
+        SDL_SetRenderDrawColor(ren, shade, shade, shade, 255);
+        SDL_Rect dot = {cx + dx[k] * radius / 10 - 2, cy + dy[k] * radius / 10 - 2, 4, 4};
+        SDL_RenderFillRect(ren, &dot);
+    }
+    SDL_Rect text_rect = {msg_bg.x + 40, msg_bg.y, msg_bg.w - 40, msg_bg.h};
+    SDL_Color black = {0, 0, 0, 255};
+    renderText(ren, env->font, "Solving... (Esc)", black, text_rect);
+}
+
+/* **************************************************************** */
+
 Env *init(SDL_Window* win, SDL_Renderer* ren, int argc, char* argv[]) {
-    Env *env = malloc(sizeof(struct Env_t));
+    Env *env = calloc(1, sizeof(struct Env_t));
     if (!env) ERROR("Memory allocation error for Env\n");
 
     env->g = (argc == 2) ? game_load(argv[1]) : game_default();
+    if (!env->g) ERROR("Unable to load %s\n", argv[1]);
+    // repeated clicks on a tile are undone at once
+    game_history_policy policy = {true, 0, HISTORY_MAX_BYTES};
+    game_set_history_policy(env->g, &policy);
     env->button_area_height = 60;
     env->margin = 20;
 
@@ -113,6 +220,9 @@ Env *init(SDL_Window* win, SDL_Renderer* ren, int argc, char* argv[]) {
 /* **************************************************************** */
 
 void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
+    // the main loop renders every DELAY ms, which is when the solve is polled
+    pollSolve(env);
+
     //Display the background
     if (env->background_texture) {
         SDL_Rect bg_rect = {0, 0, env->window_width, env->window_height};
@@ -216,6 +326,19 @@ void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
         renderText(ren, env->font, "Game Won!", green, msg_bg);
     }
 
+    //Solving spinner or status message
+    if (isSolving(env)) {
+        renderSpinner(ren, env);
+    } else if (env->message && SDL_TICKS_PASSED(SDL_GetTicks(), env->message_end)) {
+        env->message = NULL;
+    } else if (env->message) {
+        SDL_Rect msg_bg = {env->window_width/2 - 100, env->button_area_height + env->margin, 200, 40};
+        SDL_Color red = {180, 0, 0, 255};
+        SDL_SetRenderDrawColor(ren, 255, 255, 255, 230);
+        SDL_RenderFillRect(ren, &msg_bg);
+        renderText(ren, env->font, env->message, red, msg_bg);
+    }
+
     SDL_RenderPresent(ren);
 }
 
@@ -227,18 +350,23 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e) {
             return true;
 
         case SDL_KEYDOWN:
+            if (e->key.keysym.sym == SDLK_q) return true;
+            if (e->key.keysym.sym == SDLK_ESCAPE) cancelSolve(env);
+            // the grid is left alone while it is being solved
+            if (isSolving(env)) break;
             switch (e->key.keysym.sym) {
-                case SDLK_q: return true;
                 case SDLK_r: game_shuffle_orientation(env->g); break;
                 case SDLK_z: game_undo(env->g); break;
                 case SDLK_y: game_redo(env->g); break;
-                case SDLK_s:game_solve(env->g) ; break; 
+                case SDLK_s: startSolve(env); break;
             }
             break;
 
         case SDL_MOUSEBUTTONDOWN:
             if (e->button.button == SDL_BUTTON_LEFT) {
                 SDL_Point mouse_pos = {e->button.x, e->button.y};
+                // only Quit works while the grid is being solved
+                if (isSolving(env) && !SDL_PointInRect(&mouse_pos, &env->quit_btn)) break;
                 
                 if (SDL_PointInRect(&mouse_pos, &env->reset_btn)) {
                     game_shuffle_orientation(env->g);
@@ -253,8 +381,8 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e) {
                     game_redo(env->g);
                 }
                 else if (SDL_PointInRect(&mouse_pos, &env->solve_btn)) {
-                    //Solve the game
-                    game_solve(env->g);
+                    //Solve the game in the background
+                    startSolve(env);
                 }
                 else {
                     //Click to a box
@@ -298,6 +426,11 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e) {
 void clean(SDL_Window* win, SDL_Renderer* ren, Env* env) {
     if (!env) return;
 
+    if (isSolving(env)) {
+        cancelSolve(env);
+        finishSolve(env);
+    }
+
     for (int i = 0; i < 6; i++) {
         if (env->piece_textures[i]) SDL_DestroyTexture(env->piece_textures[i]);
     }